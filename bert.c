@@ -0,0 +1,574 @@
+/* Errors recorded by the firmware before the OS took over.
+
+   The ACPI Boot Error Record Table points to a region with the errors
+   of the previous boot, e.g. DIMMs failing during POST or right before
+   a reset. It holds UEFI CPER error sections that never went through
+   the machine check log. Memory sections are logged and accounted in
+   the DIMM and page databases, by the daemon once the merge of the
+   ingest sources releases them in time order. IA32/X64 processor
+   sections with a dump of the machine check bank are turned into a
+   machine check record.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "memdb.h"
+#include "page.h"
+#include "ingest.h"
+#include "msg.h"
+#include "candidate.h"
+#include "bert.h"
+
+#define BERT_STATE "/var/run/mcelog-bert"
+
+enum {
+	BERT_MAX = 1 << 20,		/* largest region read */
+};
+
+struct guid {
+	u32 a;
+	u16 b, c;
+	u8 d[8];
+} __attribute__((packed));
+
+static const struct guid sec_mem = { 0xa5bc1114, 0x6f64, 0x4ede,
+	{ 0xb8, 0x63, 0x3e, 0x83, 0xed, 0x7c, 0x83, 0xb1 } };
+static const struct guid sec_proc_ia = { 0xdc3ea0b0, 0xa144, 0x4797,
+	{ 0xb9, 0x5b, 0x53, 0xfa, 0x24, 0x2b, 0x6e, 0x1d } };
+static const struct guid sec_proc = { 0x9876ccad, 0x47b4, 0x4bdb,
+	{ 0xb6, 0x5e, 0x16, 0xf1, 0x93, 0xc4, 0xf3, 0xdb } };
+
+/* ACPI Generic Error Status Block */
+struct estatus {
+	u32 block_status;
+	u32 raw_data_offset;
+	u32 raw_data_length;
+	u32 data_length;
+	u32 error_severity;
+} __attribute__((packed));
+
+/* ACPI Generic Error Data Entry, revision 3 adds the time stamp */
+struct gdata {
+	struct guid section_type;
+	u32 error_severity;
+	u16 revision;
+	u8 validation_bits;
+	u8 flags;
+	u32 error_data_length;
+	u8 fru_id[16];
+	char fru_text[20];
+	u8 timestamp[8];
+} __attribute__((packed));
+
+#define GDATA_V2_SIZE offsetof(struct gdata, timestamp)
+#define GDATA_FRU_TEXT	(1 << 1)
+#define GDATA_TIMESTAMP	(1 << 2)
+
+/* UEFI CPER platform memory error section */
+struct cper_mem {
+	u64 validation_bits;
+	u64 error_status;
+	u64 physical_addr;
+	u64 physical_addr_mask;
+	u16 node;
+	u16 card;
+	u16 module;
+	u16 bank;
+	u16 device;
+	u16 row;
+	u16 column;
+	u16 bit_pos;
+	u64 requestor_id;
+	u64 responder_id;
+	u64 target_id;
+	u8 error_type;
+	/* added in UEFI 2.3 */
+	u8 extended;
+	u16 rank;
+	u16 mem_array_handle;
+	u16 mem_dev_handle;
+} __attribute__((packed));
+
+#define CPER_MEM_OLD_SIZE offsetof(struct cper_mem, extended)
+
+enum {
+	MEM_VALID_PA = 1 << 1,
+	MEM_VALID_NODE = 1 << 3,
+	MEM_VALID_CARD = 1 << 4,
+	MEM_VALID_MODULE = 1 << 5,
+	MEM_VALID_BANK = 1 << 6,
+	MEM_VALID_DEVICE = 1 << 7,
+	MEM_VALID_ROW = 1 << 8,
+	MEM_VALID_COLUMN = 1 << 9,
+	MEM_VALID_ERROR_TYPE = 1 << 14,
+	MEM_VALID_RANK = 1 << 15,
+};
+
+/* UEFI CPER IA32/X64 processor error section */
+struct cper_ia {
+	u64 validation_bits;
+	u64 lapic_id;
+	u32 cpuid[12];
+} __attribute__((packed));
+
+#define IA_VALID_LAPIC	(1 << 0)
+#define IA_VALID_CPUID	(1 << 1)
+#define IA_ERR_INFO_NUM(v) (((v) >> 2) & 0x3f)
+#define IA_CTX_INFO_NUM(v) (((v) >> 8) & 0x3f)
+#define IA_ERR_INFO_SIZE 64
+
+struct cper_ia_ctx {
+	u16 reg_ctx_type;
+	u16 reg_arr_size;
+	u32 msr_addr;
+	u64 mm_reg_addr;
+} __attribute__((packed));
+
+#define CTX_TYPE_MSR 1
+#define MSR_MC0_CTL 0x400
+#define MSR_MC_LAST 0x47f
+
+static const char *severity_name[] = {
+	"recoverable", "fatal", "corrected", "informational"
+};
+
+static const char *mem_error_type[] = {
+	"unknown", "no error", "single-bit ECC", "multi-bit ECC",
+	"single-symbol chipkill ECC", "multi-symbol chipkill ECC",
+	"master abort", "target abort", "parity error", "watchdog timeout",
+	"invalid address", "mirror broken", "memory sparing",
+	"scrub corrected error", "scrub uncorrected error",
+	"physical memory map-out event",
+};
+
+static struct {
+	unsigned memory;
+	unsigned mce;
+	unsigned other;
+} bert_stats;
+
+static unsigned bcd(u8 v)
+{
+	return (v >> 4) * 10 + (v & 0xf);
+}
+
+/* CPER time stamp: BCD seconds, minutes, hours, flags, day, month, year, century */
+static time_t gdata_time(struct gdata *g)
+{
+	struct tm tm = {};
+
+	if ((g->revision >> 8) < 3 || !(g->validation_bits & GDATA_TIMESTAMP))
+		return 0;
+	tm.tm_sec = bcd(g->timestamp[0]);
+	tm.tm_min = bcd(g->timestamp[1]);
+	tm.tm_hour = bcd(g->timestamp[2]);
+	tm.tm_mday = bcd(g->timestamp[4]);
+	tm.tm_mon = bcd(g->timestamp[5]) - 1;
+	tm.tm_year = bcd(g->timestamp[7]) * 100 + bcd(g->timestamp[6]) - 1900;
+	return timegm(&tm);
+}
+
+static void bert_header(struct gdata *g, char *what, time_t t)
+{
+	Wprintf("Boot error record: %s %s\n",
+		g->error_severity < NELE(severity_name) ?
+			severity_name[g->error_severity] : "unknown", what);
+	if (g->validation_bits & GDATA_FRU_TEXT)
+		Wprintf("FRU \"%.20s\"\n", g->fru_text);
+	if (t)
+		Wprintf("TIME %lu %s", (unsigned long)t, ctime(&t));
+}
+
+/* A memory section, kept until the merge releases it in time order */
+struct bert_mem {
+	struct gdata g;
+	struct cper_mem mem;
+	u32 len;
+	time_t t;
+};
+
+static struct bert_mem *mem_queue;
+static unsigned mem_queued, mem_released;
+static int mem_merge;			/* queue sections for the merge */
+
+static void bert_mem_process(struct mce *m, int index);
+
+static struct ingest_source mem_source = {
+	.name = "bert-memory",
+	.process = bert_mem_process,
+};
+
+/* Turn the section into a record for the DIMM and page databases */
+static int bert_mem_record(struct bert_mem *e, u64 v, struct mce *m,
+			   int *channel, int *dimm, enum mem_source *src)
+{
+	struct cper_mem *mem = &e->mem;
+
+	/* Only the node is needed to account it for the socket */
+	if (!(v & MEM_VALID_NODE))
+		return 0;
+	memset(m, 0, sizeof(struct mce));
+	m->status = MCI_STATUS_VAL | MCI_STATUS_EN;
+	if (e->g.error_severity < 2)
+		m->status |= MCI_STATUS_UC;
+	if (v & MEM_VALID_PA) {
+		m->status |= MCI_STATUS_ADDRV;
+		m->addr = mem->physical_addr;
+	}
+	m->socketid = mem->node;
+	m->time = e->t ? e->t : time(NULL);
+	m->finished = 1;
+	/* the card is the memory controller channel, the module the DIMM */
+	if (v & MEM_VALID_CARD)
+		channel[0] = mem->card;
+	if (v & MEM_VALID_MODULE)
+		dimm[0] = mem->module;
+	*src = MEM_SRC_OTHER;
+	if (v & MEM_VALID_ERROR_TYPE) {
+		if (mem->error_type == 13 || mem->error_type == 14)
+			*src = MEM_SRC_SCRUB;
+		else if (mem->error_type == 12)
+			*src = MEM_SRC_SPARE;
+	}
+	return 1;
+}
+
+static void bert_mem_account(struct mce *m, int *channel, int *dimm,
+			     enum mem_source src)
+{
+	memory_error(m, channel, dimm, 0, sizeof(struct mce), src);
+	account_page_error(m, channel, dimm, src);
+}
+
+/* Log a memory section and account it */
+static void bert_mem_log(struct bert_mem *e)
+{
+	struct cper_mem *mem = &e->mem;
+	struct mce m;
+	u64 v = mem->validation_bits;
+	int channel[2] = { -1, -1 }, dimm[2] = { -1, -1 };
+	enum mem_source src;
+	int n = 0;
+	char *what;
+
+	if (e->len < sizeof(struct cper_mem))
+		v &= ~(u64)MEM_VALID_RANK;
+
+	xasprintf(&what, "memory error%s%s",
+		(v & MEM_VALID_ERROR_TYPE) ? ", " : "",
+		!(v & MEM_VALID_ERROR_TYPE) ? "" :
+		mem->error_type < NELE(mem_error_type) ?
+			mem_error_type[mem->error_type] : "unknown type");
+	bert_header(&e->g, what, e->t);
+	free(what);
+	what = NULL;
+
+	if (v & MEM_VALID_PA)
+		n += Wprintf("ADDR %llx ", mem->physical_addr);
+	if (v & MEM_VALID_NODE)
+		n += Wprintf("NODE %u ", mem->node);
+	if (v & MEM_VALID_CARD)
+		n += Wprintf("CARD %u ", mem->card);
+	if (v & MEM_VALID_MODULE)
+		n += Wprintf("MODULE %u ", mem->module);
+	if (v & MEM_VALID_RANK)
+		n += Wprintf("RANK %u ", mem->rank);
+	if (v & MEM_VALID_BANK)
+		n += Wprintf("BANK %u ", mem->bank);
+	if (v & MEM_VALID_DEVICE)
+		n += Wprintf("DEVICE %u ", mem->device);
+	if (v & MEM_VALID_ROW)
+		n += Wprintf("ROW %u ", mem->row);
+	if (v & MEM_VALID_COLUMN)
+		n += Wprintf("COLUMN %u ", mem->column);
+	if (n > 0)
+		Wprintf("\n");
+
+	if (!bert_mem_record(e, v, &m, channel, dimm, &src))
+		return;
+	bert_mem_account(&m, channel, dimm, src);
+	/* the candidate policy accounts the same error again */
+	if (candidate_begin(&m)) {
+		bert_mem_account(&m, channel, dimm, src);
+		candidate_end();
+	}
+}
+
+/* A memory section released by ingest in time order */
+static void bert_mem_process(struct mce *m, int index)
+{
+	(void)m;
+	bert_mem_log(&mem_queue[index]);
+	flushlog();
+	if (++mem_released == mem_queued) {
+		free(mem_queue);
+		mem_queue = NULL;
+		mem_queued = mem_released = 0;
+	}
+}
+
+/*
+ * The daemon passes memory sections through the merge, so that they
+ * are accounted in time order with the other sources. --bert logs
+ * them right away.
+ */
+static void bert_memory(struct gdata *g, struct cper_mem *mem, u32 len, time_t t)
+{
+	struct bert_mem *e, one;
+	struct mce m;
+
+	if (len < CPER_MEM_OLD_SIZE)
+		return;
+	bert_stats.memory++;
+	if (!mem_merge) {
+		e = &one;
+	} else {
+		mem_queue = xrealloc(mem_queue, (mem_queued + 1) * sizeof(struct bert_mem));
+		e = &mem_queue[mem_queued];
+	}
+	memset(e, 0, sizeof(struct bert_mem));
+	e->g = *g;
+	memcpy(&e->mem, mem, len < sizeof(struct cper_mem) ? len : sizeof(struct cper_mem));
+	e->len = len;
+	e->t = t;
+	if (e == &one) {
+		bert_mem_log(e);
+		return;
+	}
+	/* the section number keeps the order and tells equal sections apart */
+	memset(&m, 0, sizeof(struct mce));
+	m.status = MCI_STATUS_VAL;
+	m.time = t ? t : time(NULL);
+	m.tsc = mem_queued;
+	m.finished = 1;
+	ingest_push(&mem_source, &m, sizeof(struct mce), mem_queued++);
+}
+
+/* Machine check banks dumped as MSR context become machine check records */
+static void bert_processor(struct gdata *g, struct cper_ia *ia, u32 len, time_t t,
+			   bert_mce_cb cb)
+{
+	unsigned char *p = (unsigned char *)ia, *end = p + len;
+	struct cper_ia_ctx *ctx;
+	u64 *regs;
+	unsigned i, first, nregs;
+	int found = 0;
+
+	if (len < sizeof(struct cper_ia))
+		return;
+	p += sizeof(struct cper_ia) +
+		IA_ERR_INFO_NUM(ia->validation_bits) * IA_ERR_INFO_SIZE;
+	for (i = 0; i < IA_CTX_INFO_NUM(ia->validation_bits); i++) {
+		struct mce m = {};
+
+		ctx = (struct cper_ia_ctx *)p;
+		if (p + sizeof(*ctx) > end ||
+		    p + sizeof(*ctx) + ctx->reg_arr_size > end)
+			break;
+		p += sizeof(*ctx) + ctx->reg_arr_size;
+		if (ctx->reg_ctx_type != CTX_TYPE_MSR ||
+		    ctx->msr_addr < MSR_MC0_CTL || ctx->msr_addr > MSR_MC_LAST)
+			continue;
+		/* the dump starts at MCi_CTL or MCi_STATUS */
+		regs = (u64 *)(ctx + 1);
+		nregs = ctx->reg_arr_size / 8;
+		first = ctx->msr_addr & 3;
+		if (first > 1 || nregs < 2 - first)
+			continue;
+		m.status = regs[1 - first];
+		if (!(m.status & MCI_STATUS_VAL))
+			continue;
+		if (nregs > 2 - first)
+			m.addr = regs[2 - first];
+		if (nregs > 3 - first)
+			m.misc = regs[3 - first];
+		m.bank = (ctx->msr_addr - MSR_MC0_CTL) / 4;
+		if (ia->validation_bits & IA_VALID_LAPIC)
+			m.apicid = ia->lapic_id;
+		if (ia->validation_bits & IA_VALID_CPUID)
+			m.cpuid = ia->cpuid[0];
+		m.time = t;
+		m.finished = 1;
+		if (!found++)
+			bert_header(g, "processor error", t);
+		bert_stats.mce++;
+		cb(&m);
+	}
+	if (!found)
+		bert_stats.other++;
+}
+
+static void bert_section(struct gdata *g, void *data, u32 len, bert_mce_cb cb)
+{
+	time_t t = gdata_time(g);
+
+	if (!memcmp(&g->section_type, &sec_mem, sizeof(struct guid)))
+		bert_memory(g, data, len, t);
+	else if (!memcmp(&g->section_type, &sec_proc_ia, sizeof(struct guid)))
+		bert_processor(g, data, len, t, cb);
+	else {
+		bert_stats.other++;
+		if (!memcmp(&g->section_type, &sec_proc, sizeof(struct guid)))
+			bert_header(g, "processor error", t);
+	}
+}
+
+/* Walk all error status blocks and their data entries */
+static int bert_parse(unsigned char *buf, size_t len, bert_mce_cb cb)
+{
+	unsigned char *p = buf, *end = buf + len;
+
+	memset(&bert_stats, 0, sizeof(bert_stats));
+	while (p + sizeof(struct estatus) <= end) {
+		struct estatus *es = (struct estatus *)p;
+		unsigned char *d, *dend;
+		size_t eslen;
+
+		if (es->block_status == 0)
+			break;
+		eslen = sizeof(*es) + (size_t)es->data_length;
+		if (es->raw_data_offset &&
+		    (size_t)es->raw_data_offset + es->raw_data_length > eslen)
+			eslen = (size_t)es->raw_data_offset + es->raw_data_length;
+		if (eslen > (size_t)(end - p)) {
+			Eprintf("Boot error region truncated\n");
+			return -1;
+		}
+		d = p + sizeof(*es);
+		dend = d + es->data_length;
+		while (d + GDATA_V2_SIZE <= dend) {
+			struct gdata *g = (struct gdata *)d;
+			size_t glen = (g->revision >> 8) >= 3 ? sizeof(*g) : GDATA_V2_SIZE;
+
+			if (d + glen + g->error_data_length > dend)
+				break;
+			bert_section(g, d + glen, g->error_data_length, cb);
+			d += glen + g->error_data_length;
+		}
+		p += eslen;
+	}
+	return 0;
+}
+
+static int bert_read(const char *file, unsigned char **buf, size_t *len)
+{
+	FILE *f;
+
+	f = fopen(file, "r");
+	if (!f)
+		return -1;
+	*buf = xalloc(BERT_MAX);
+	*len = fread(*buf, 1, BERT_MAX, f);
+	fclose(f);
+	return 0;
+}
+
+static void bert_summary(const char *file)
+{
+	Lprintf("Boot error records in %s: %u memory, %u machine check, %u other\n",
+		file, bert_stats.memory, bert_stats.mce, bert_stats.other);
+}
+
+/* Decode a captured table for --bert */
+int bert_decode(const char *file, bert_mce_cb cb)
+{
+	unsigned char *buf;
+	size_t len;
+	int ret;
+
+	if (bert_read(file, &buf, &len) < 0) {
+		SYSERRprintf("Cannot read boot error region `%s'", file);
+		return -1;
+	}
+	ret = bert_parse(buf, len, cb);
+	free(buf);
+	buf = NULL;
+	bert_summary(file);
+	return ret;
+}
+
+static u64 fnv64(unsigned char *p, size_t len)
+{
+	u64 h = 0xcbf29ce484222325ULL;
+
+	while (len--)
+		h = (h ^ *p++) * 0x100000001b3ULL;
+	return h;
+}
+
+/*
+ * Process the boot errors once when the daemon starts. The state file
+ * records the region processed last, so that a restarted daemon does
+ * not account the same errors again.
+ */
+void bert_setup(bert_mce_cb cb)
+{
+	char *file = BERT_FILE, *state = BERT_STATE, *s;
+	unsigned long long last = 0;
+	unsigned char *buf;
+	size_t len;
+	FILE *f;
+	u64 sum;
+
+	if (config_bool("bert", "bert-enabled") == 0)
+		return;
+	if ((s = config_string("bert", "bert-file")) != NULL)
+		file = s;
+	if ((s = config_string("bert", "bert-state-file")) != NULL)
+		state = s;
+
+	if (bert_read(file, &buf, &len) < 0) {
+		if (errno != ENOENT)
+			SYSERRprintf("Cannot read boot error region `%s'", file);
+		return;
+	}
+	sum = fnv64(buf, len);
+	f = fopen(state, "r");
+	if (f) {
+		if (fscanf(f, "%llx", &last) != 1)
+			last = 0;
+		fclose(f);
+	}
+	if (len == 0 || last == sum) {
+		free(buf);
+		return;
+	}
+
+	ingest_register(&mem_source);
+	mem_merge = 1;
+	bert_parse(buf, len, cb);
+	mem_merge = 0;
+	ingest_close(&mem_source);
+	free(buf);
+	buf = NULL;
+	bert_summary(file);
+
+	f = fopen(state, "w");
+	if (!f) {
+		SYSERRprintf("Cannot write boot error state file `%s'", state);
+		return;
+	}
+	fprintf(f, "%llx %u %u %u\n", sum, bert_stats.memory, bert_stats.mce,
+		bert_stats.other);
+	fclose(f);
+}
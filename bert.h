@@ -0,0 +1,7 @@
+#define BERT_FILE "/sys/firmware/acpi/tables/data/BERT"
+
+struct mce;
+typedef void (*bert_mce_cb)(struct mce *m);
+
+int bert_decode(const char *file, bert_mce_cb cb);
+void bert_setup(bert_mce_cb cb);
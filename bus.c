@@ -16,7 +16,6 @@
    on your Linux system. */
 #define _GNU_SOURCE 1
 #include <stdio.h>
-#include <assert.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -27,10 +26,7 @@
 #include "bus.h"
 
 static char *bus_trigger, *iomca_trigger;
-
-enum {
-	MAX_ENV = 20,
-};
+static struct trigger_template bus_env;
 
 void bus_setup(void)
 {
@@ -47,14 +43,13 @@ void bus_setup(void)
 				iomca_trigger);
 		exit(1);
 	}
+	trigger_template_init(&bus_env);
 }
 
 void run_bus_trigger(int socket, int cpu, char *level, char *pp, char *rrrr,
 		char *ii, char *timeout)
 {
-	int ei = 0;
-	char *env[MAX_ENV];
-	int i;
+	struct trigger_env env;
 	char *msg;
 	char *location;
 
@@ -67,36 +62,29 @@ void run_bus_trigger(int socket, int cpu, char *level, char *pp, char *rrrr,
 		xasprintf(&location, "CPU %d", cpu);
 	xasprintf(&msg, "%s received Bus and Interconnect Errors in %s",
 		location, ii);
-	xasprintf(&env[ei++], "LOCATION=%s", location);
+	trigger_env_init(&env, &bus_env);
+	trigger_env_add(&env, "LOCATION=%s", location);
 	free(location);
 	location = NULL;
 
 	if (socket >= 0)
-		xasprintf(&env[ei++], "SOCKETID=%d", socket);
-	xasprintf(&env[ei++], "MESSAGE=%s", msg);
-	xasprintf(&env[ei++], "CPU=%d", cpu);
-	xasprintf(&env[ei++], "LEVEL=%s", level);
-	xasprintf(&env[ei++], "PARTICIPATION=%s", pp);
-	xasprintf(&env[ei++], "REQUEST=%s", rrrr);
-	xasprintf(&env[ei++], "ORIGIN=%s", ii);
-	xasprintf(&env[ei++], "TIMEOUT=%s", timeout);
-	env[ei] = NULL;
-	assert(ei < MAX_ENV);
-
-	run_trigger(bus_trigger, NULL, env, false, "bus");
-	for (i = 0; i < ei; i++) {
-		free(env[i]);
-		env[i] = NULL;
-	}
+		trigger_env_add(&env, "SOCKETID=%d", socket);
+	trigger_env_add(&env, "MESSAGE=%s", msg);
+	trigger_env_add(&env, "CPU=%d", cpu);
+	trigger_env_add(&env, "LEVEL=%s", level);
+	trigger_env_add(&env, "PARTICIPATION=%s", pp);
+	trigger_env_add(&env, "REQUEST=%s", rrrr);
+	trigger_env_add(&env, "ORIGIN=%s", ii);
+	trigger_env_add(&env, "TIMEOUT=%s", timeout);
+
+	run_trigger(bus_trigger, NULL, trigger_env(&env), false, "bus");
 	free(msg);
 	msg = NULL;
 }
 
 void run_iomca_trigger(int socket, int cpu, int seg, int bus, int dev, int fn)
 {
-	int ei = 0;
-	char *env[MAX_ENV];
-	int i;
+	struct trigger_env env;
 	char *msg;
 	char *location;
 
@@ -109,26 +97,21 @@ void run_iomca_trigger(int socket, int cpu, int seg, int bus, int dev, int fn)
 		xasprintf(&location, "CPU %d", cpu);
 	xasprintf(&msg, "%s received IO MCA Errors from %x:%02x:%02x.%x",
 		location, seg, bus, dev, fn);
-	xasprintf(&env[ei++], "LOCATION=%s", location);
+	trigger_env_init(&env, &bus_env);
+	trigger_env_add(&env, "LOCATION=%s", location);
 	free(location);
 	location = NULL;
 
 	if (socket >= 0)
-		xasprintf(&env[ei++], "SOCKETID=%d", socket);
-	xasprintf(&env[ei++], "MESSAGE=%s", msg);
-	xasprintf(&env[ei++], "CPU=%d", cpu);
-	xasprintf(&env[ei++], "SEG=%x", seg);
-	xasprintf(&env[ei++], "BUS=%02x", bus);
-	xasprintf(&env[ei++], "DEVICE=%02x", dev);
-	xasprintf(&env[ei++], "FUNCTION=%x", fn);
-	env[ei] = NULL;
-	assert(ei < MAX_ENV);
-
-	run_trigger(iomca_trigger, NULL, env, false, "iomca");
-	for (i = 0; i < ei; i++) {
-		free(env[i]);
-		env[i] = NULL;
-	}
+		trigger_env_add(&env, "SOCKETID=%d", socket);
+	trigger_env_add(&env, "MESSAGE=%s", msg);
+	trigger_env_add(&env, "CPU=%d", cpu);
+	trigger_env_add(&env, "SEG=%x", seg);
+	trigger_env_add(&env, "BUS=%02x", bus);
+	trigger_env_add(&env, "DEVICE=%02x", dev);
+	trigger_env_add(&env, "FUNCTION=%x", fn);
+
+	run_trigger(iomca_trigger, NULL, trigger_env(&env), false, "iomca");
 	free(msg);
 	msg = NULL;
 }
@@ -25,6 +25,7 @@
 #include "mcelog.h"
 #include "memutil.h"
 #include "sysfs.h"
+#include "config.h"
 #include "cache.h"
 
 struct cache { 
@@ -38,7 +39,8 @@ struct cache {
 struct cache **caches;
 static unsigned cachelen;
 
-#define PREFIX "/sys/devices/system/cpu"
+#define SYSFS "/sys"
+#define PREFIX "devices/system/cpu"
 #define MIN_CPUS 8
 #define MIN_INDEX 4
 
@@ -57,7 +59,7 @@ static void more_cpus(unsigned cpu)
 	if (cachelen < cpu)
 		cachelen = cpu + 1;
 	cachelen = cachelen * 2;
-	caches = xrealloc(caches, cachelen * sizeof(struct cache *));
+	caches = xrealloc_tag(MEM_CACHE, caches, cachelen * sizeof(struct cache *));
 	memset(caches + old, 0, (cachelen - old) * sizeof(struct cache *));
 }
 
@@ -104,7 +106,7 @@ static void read_cpu_map(struct cache *c, char *cfn)
 		goto out;
 	}
 	c->cpumaplen = cpumap_len(map);
-	c->cpumap = xalloc(c->cpumaplen);
+	c->cpumap = xalloc_tag(MEM_CACHE, c->cpumaplen);
 	parse_cpumap(map, c->cpumap, c->cpumaplen);
 out:
 	free(map);
@@ -113,10 +115,16 @@ out:
 
 static int read_caches(void)
 {
-	DIR *cpus = opendir(PREFIX);
+	char *root = config_string("cache", "cache-sysfs");
+	char *dir;
+	DIR *cpus;
 	struct dirent *de;
+
+	xasprintf(&dir, "%s/%s", root ? root : SYSFS, PREFIX);
+	cpus = opendir(dir);
 	if (!cpus) { 
-		Wprintf("Cannot read cache topology from %s", PREFIX);
+		Wprintf("Cannot read cache topology from %s\n", dir);
+		free(dir);
 		return -1;
 	}
 	while ((de = readdir(cpus)) != NULL) {
@@ -127,7 +135,7 @@ static int read_caches(void)
 			int i;
 			int numindex;
 
-			xasprintf(&fn, "%s/%s/cache", PREFIX, de->d_name);
+			xasprintf(&fn, "%s/%s/cache", dir, de->d_name);
 			if (!stat(fn, &st)) {
 				numindex = st.st_nlink - 2;
 				if (numindex < 0)
@@ -135,7 +143,7 @@ static int read_caches(void)
 				if (cpu >= cachelen)
 					more_cpus(cpu);
 				assert(cpu < cachelen);
-				caches[cpu] = xalloc(sizeof(struct cache) * 
+				caches[cpu] = xalloc_tag(MEM_CACHE, sizeof(struct cache) * 
 						     (numindex+1));
 				for (i = 0; i < numindex; i++) {
 					char *cfn;
@@ -153,6 +161,7 @@ static int read_caches(void)
 		}
 	}
 	closedir(cpus);
+	free(dir);
 	return 0;
 }
 
@@ -164,11 +173,11 @@ int cache_to_cpus(int cpu, unsigned level, unsigned type,
 		if (read_caches() < 0)
 			return -1;
 		if (!caches) { 
-			Wprintf("No caches found in sysfs");
+			Wprintf("No caches found in sysfs\n");
 			return -1;
 		}
 	}
-	for (c = caches[cpu]; c && c->cpumap; c++) { 
+	for (c = (unsigned)cpu < cachelen ? caches[cpu] : NULL; c && c->cpumap; c++) { 
 		//printf("%d level %d type %d\n", cpu, c->level, c->type);
 		if (c->level == level && (c->type == type || c->type == UNIFIED)) {
 			*cpumap = c->cpumap;
@@ -176,7 +185,7 @@ int cache_to_cpus(int cpu, unsigned level, unsigned type,
 			return 0;
 		}
 	}
-	Wprintf("Cannot find sysfs cache for CPU %d", cpu);
+	Wprintf("Cannot find sysfs cache for CPU %d\n", cpu);
 	return -1;
 }
 
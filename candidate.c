@@ -0,0 +1,179 @@
+/* Evaluate a candidate memory error policy on the live stream.
+
+   Before new page and DIMM thresholds are rolled out, their effect can
+   be watched on the real errors of a node. The candidate settings come
+   from the [candidate-page], [candidate-dimm] and [candidate-socket]
+   sections; anything not set there is taken from the live sections.
+   Every real record is accounted a second time, in place, into the
+   page and DIMM databases of the candidate, and its cache threshold
+   indications into cache instances of the candidate. Its offlines,
+   triggers and threshold reports are only logged and kept for the
+   candidate server command. Link errors, power events and the bus, IO
+   MCA and unknown error triggers are not evaluated. The candidate tracks a limited number of pages, its memory
+   is accounted separately and the CPU time it may use is capped.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "trigger.h"
+#include "memdb.h"
+#include "page.h"
+#include "yellow.h"
+#include "candidate.h"
+
+enum {
+	DECISIONS = 64,		/* recent decisions kept for the server */
+};
+
+struct decision {
+	time_t t;
+	char *msg;
+};
+
+static int candidate_enabled;
+static int stopped;			/* over the memory limit */
+static unsigned cpu_limit = 5;		/* percent */
+static unsigned max_pages = 1024;
+static unsigned max_dimms = 256;
+static struct decision decisions[DECISIONS];
+static unsigned next_decision;
+static unsigned long ndecisions, evaluated, skipped;
+static unsigned long long cpu_ns, window_ns;
+static time_t window;
+static time_t current;			/* of the record being evaluated */
+static struct timespec cpu_start;
+
+static unsigned long long cpu_now(struct timespec *ts)
+{
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, ts);
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* What the candidate would have done */
+static void candidate_action(const char *fmt, ...)
+{
+	struct decision *d = &decisions[next_decision];
+	va_list ap;
+	char *msg;
+
+	va_start(ap, fmt);
+	xvasprintf(&msg, fmt, ap);
+	va_end(ap);
+	Lprintf("Candidate policy: would %s\n", msg);
+	xfree_tag(MEM_POLICY, d->msg);
+	mem_track(MEM_POLICY, msg);
+	d->msg = msg;
+	d->t = current;
+	next_decision = (next_decision + 1) % DECISIONS;
+	ndecisions++;
+}
+
+/* Stop the evaluation instead of letting it grow without bound */
+static void candidate_evict(size_t excess)
+{
+	(void)excess;
+	if (stopped)
+		return;
+	Lprintf("Candidate policy over its memory limit, evaluation stopped\n");
+	stopped = 1;
+}
+
+/*
+ * Switch to the candidate for the record m, unless it used up its CPU
+ * time in the current second. Returns 0 when m is not evaluated.
+ */
+int candidate_begin(struct mce *m)
+{
+	struct timespec now;
+
+	if (!candidate_enabled || stopped)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec != window) {
+		window = now.tv_sec;
+		window_ns = 0;
+	}
+	if (window_ns >= cpu_limit * 10000000ULL) {
+		skipped++;
+		return 0;
+	}
+	evaluated++;
+	current = m->time;
+	cpu_now(&cpu_start);
+	dry_run = candidate_action;
+	memdb_use(DB_CANDIDATE);
+	page_use(DB_CANDIDATE);
+	yellow_use(DB_CANDIDATE);
+	return 1;
+}
+
+void candidate_end(void)
+{
+	struct timespec now;
+	unsigned long long ns;
+
+	yellow_use(DB_LIVE);
+	page_use(DB_LIVE);
+	memdb_use(DB_LIVE);
+	dry_run = NULL;
+	ns = cpu_now(&now) - (cpu_start.tv_sec * 1000000000ULL + cpu_start.tv_nsec);
+	cpu_ns += ns;
+	window_ns += ns;
+}
+
+void dump_candidate(FILE *f)
+{
+	struct decision *d;
+	unsigned i, n;
+
+	if (!candidate_enabled) {
+		fprintf(f, "Candidate policy not enabled\n");
+		return;
+	}
+	fprintf(f, "Candidate policy: evaluated %lu records, skipped %lu over the CPU limit of %u%%%s\n",
+		evaluated, skipped, cpu_limit, stopped ? ", stopped over the memory limit" : "");
+	fprintf(f, "CPU time: total %lluus avg %lluus\n", cpu_ns / 1000,
+		evaluated ? cpu_ns / 1000 / evaluated : 0);
+	fprintf(f, "Memory: %zu bytes, %d of %u pages, %d DIMMs\n",
+		mem_usage(MEM_POLICY), page_numpages(DB_CANDIDATE), max_pages,
+		memdb_numdimms(DB_CANDIDATE));
+	fprintf(f, "Not evaluated: link errors, power events, bus, IO MCA and unknown error triggers\n");
+	fprintf(f, "Decisions: %lu\n", ndecisions);
+	n = ndecisions < DECISIONS ? ndecisions : DECISIONS;
+	for (i = 0; i < n; i++) {
+		d = &decisions[(next_decision + DECISIONS - n + i) % DECISIONS];
+		fprintf(f, "%lu: would %s\n", (unsigned long)d->t, d->msg);
+	}
+}
+
+void candidate_setup(void)
+{
+	if (config_bool("candidate", "candidate-enabled") != 1)
+		return;
+	config_number("candidate", "cpu-limit", "%u", &cpu_limit);
+	config_number("candidate", "max-pages", "%u", &max_pages);
+	config_number("candidate", "max-dimms", "%u", &max_dimms);
+	memdb_candidate_config(max_dimms);
+	page_candidate_config(max_pages);
+	mem_set_evict(MEM_POLICY, candidate_evict);
+	candidate_enabled = 1;
+}
@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+struct mce;
+
+void candidate_setup(void);
+int candidate_begin(struct mce *m);
+void candidate_end(void);
+void dump_candidate(FILE *f);
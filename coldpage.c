@@ -0,0 +1,365 @@
+/* Cold tier of the page error database.
+
+   Most pages with corrected errors see one or two errors and never
+   again. Instead of holding a struct mempage each, pages pushed out of
+   the hot database are kept here in compact form: sorted by page frame
+   number and packed into small blocks as a varint delta to the previous
+   frame, a varint count of all its errors, an 8 bit count of the errors
+   still in the leaky bucket and a 16 bit hour time stamp. A page that
+   sees another error is promoted back with its counts, so slowly
+   developing faults still reach the threshold.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "coldpage.h"
+
+enum {
+	COLD_DATA = 240,			/* encoded bytes per block */
+	COLD_MAX = COLD_DATA / 5,		/* entries per block, 5 bytes minimum each */
+};
+
+struct cold_block {
+	unsigned short n;
+	unsigned short len;
+	u64 first;			/* frame number of the first entry */
+	unsigned char data[COLD_DATA];
+};
+
+struct cold_entry {
+	u64 pfn;
+	unsigned total;			/* errors since the page was tracked */
+	unsigned char count;		/* errors in the bucket */
+	unsigned short hour;
+};
+
+static struct cold_block **blocks;	/* sorted by first */
+static unsigned nblocks, maxblocks;
+static unsigned long entries;
+static unsigned long max_entries;
+static unsigned agetime;
+
+static struct {
+	unsigned long demoted;
+	unsigned long promoted;
+	unsigned long expired;
+	unsigned long dropped;
+} cold_stats;
+
+void cold_setup(unsigned long max, unsigned age)
+{
+	max_entries = max;
+	agetime = age;
+}
+
+static unsigned short hour_of(time_t t)
+{
+	return (t / 3600) & 0xffff;
+}
+
+/* Age in hours of a stamp, modulo the 16 bit wrap */
+static unsigned hours_since(unsigned short hour, time_t now)
+{
+	return (unsigned short)(hour_of(now) - hour);
+}
+
+static unsigned char *get_varint(unsigned char *p, u64 *v)
+{
+	int shift = 0;
+
+	*v = 0;
+	do {
+		*v |= (u64)(*p & 0x7f) << shift;
+		shift += 7;
+	} while (*p++ & 0x80);
+	return p;
+}
+
+static unsigned char *put_varint(unsigned char *p, u64 v)
+{
+	while (v >= 0x80) {
+		*p++ = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+static int cold_decode(struct cold_block *b, struct cold_entry *e)
+{
+	unsigned char *p = b->data;
+	u64 pfn = b->first, v;
+	int i;
+
+	for (i = 0; i < b->n; i++) {
+		p = get_varint(p, &v);
+		pfn += v;
+		e[i].pfn = pfn;
+		p = get_varint(p, &v);
+		e[i].total = v;
+		e[i].count = *p++;
+		e[i].hour = p[0] | (p[1] << 8);
+		p += 2;
+	}
+	return b->n;
+}
+
+/* Returns -1 when the entries do not fit into one block */
+static int cold_encode(struct cold_block *b, struct cold_entry *e, int n)
+{
+	unsigned char buf[COLD_DATA + 24], *p = buf;
+	u64 prev;
+	int i;
+
+	if (n > COLD_MAX)
+		return -1;
+	prev = n ? e[0].pfn : 0;
+	for (i = 0; i < n; i++) {
+		p = put_varint(p, e[i].pfn - prev);
+		prev = e[i].pfn;
+		p = put_varint(p, e[i].total);
+		*p++ = e[i].count;
+		*p++ = e[i].hour & 0xff;
+		*p++ = e[i].hour >> 8;
+		if (p - buf > COLD_DATA)
+			return -1;
+	}
+	b->n = n;
+	b->len = p - buf;
+	b->first = n ? e[0].pfn : 0;
+	memcpy(b->data, buf, b->len);
+	return 0;
+}
+
+/* Index of the block that covers pfn, or would get it */
+static unsigned cold_find(u64 pfn)
+{
+	unsigned lo = 0, hi = nblocks;
+
+	while (hi - lo > 1) {
+		unsigned mid = (lo + hi) / 2;
+		if (blocks[mid]->first <= pfn)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void cold_block_insert(unsigned i, struct cold_block *b)
+{
+	if (nblocks == maxblocks) {
+		maxblocks = maxblocks ? maxblocks * 2 : 16;
+		blocks = xrealloc_tag(MEM_PAGE, blocks, maxblocks * sizeof(*blocks));
+	}
+	memmove(blocks + i + 1, blocks + i, (nblocks - i) * sizeof(*blocks));
+	blocks[i] = b;
+	nblocks++;
+}
+
+static void cold_block_remove(unsigned i)
+{
+	xfree_tag(MEM_PAGE, blocks[i]);
+	nblocks--;
+	memmove(blocks + i, blocks + i + 1, (nblocks - i) * sizeof(*blocks));
+}
+
+/* Store entries into block i, splitting it when they do not fit */
+static void cold_store(unsigned i, struct cold_entry *e, int n)
+{
+	struct cold_block *nb;
+	int half;
+
+	if (n == 0) {
+		cold_block_remove(i);
+		return;
+	}
+	if (cold_encode(blocks[i], e, n) == 0)
+		return;
+	half = n / 2;
+	nb = xalloc_tag(MEM_PAGE, sizeof(struct cold_block));
+	cold_encode(blocks[i], e, half);
+	cold_encode(nb, e + half, n - half);
+	cold_block_insert(i + 1, nb);
+}
+
+/* Drop entries whose errors would have aged out of the leaky bucket */
+static void cold_expire(time_t now)
+{
+	struct cold_entry e[COLD_MAX + 1];
+	unsigned hours = (agetime + 3599) / 3600;
+	unsigned i;
+	int n, k, j;
+
+	for (i = 0; i < nblocks; i++) {
+		n = cold_decode(blocks[i], e);
+		for (j = k = 0; j < n; j++) {
+			if (hours_since(e[j].hour, now) > hours)
+				continue;
+			e[k++] = e[j];
+		}
+		if (k == n)
+			continue;
+		cold_stats.expired += n - k;
+		entries -= n - k;
+		cold_store(i, e, k);
+		if (k == 0)
+			i--;	/* block i was removed, wraps to 0 */
+	}
+}
+
+/* Still too many: drop the block with the oldest most recent error */
+static void cold_drop(time_t now)
+{
+	struct cold_entry e[COLD_MAX + 1];
+	unsigned i, victim = 0, age, best = 0;
+	int n, j;
+
+	for (i = 0; i < nblocks; i++) {
+		n = cold_decode(blocks[i], e);
+		age = -1U;
+		for (j = 0; j < n; j++)
+			if (hours_since(e[j].hour, now) < age)
+				age = hours_since(e[j].hour, now);
+		if (age >= best) {
+			best = age;
+			victim = i;
+		}
+	}
+	cold_stats.dropped += blocks[victim]->n;
+	entries -= blocks[victim]->n;
+	cold_block_remove(victim);
+}
+
+/*
+ * Demote a page from the hot database with the errors in its bucket and
+ * all its errors.
+ */
+void cold_put(u64 pfn, unsigned count, unsigned total, time_t t)
+{
+	struct cold_entry e[COLD_MAX + 1];
+	unsigned i;
+	int n, j;
+
+	if (!max_entries || count == 0)
+		return;
+	if (count > 255)
+		count = 255;
+	if (nblocks == 0)
+		cold_block_insert(0, xalloc_tag(MEM_PAGE, sizeof(struct cold_block)));
+	i = cold_find(pfn);
+	n = cold_decode(blocks[i], e);
+	for (j = 0; j < n && e[j].pfn < pfn; j++)
+		;
+	if (j < n && e[j].pfn == pfn) {
+		if (count > e[j].count)
+			e[j].count = count;
+		if (total > e[j].total)
+			e[j].total = total;
+	} else {
+		memmove(e + j + 1, e + j, (n - j) * sizeof(*e));
+		e[j].pfn = pfn;
+		e[j].count = count;
+		e[j].total = total;
+		n++;
+		entries++;
+	}
+	e[j].hour = hour_of(t);
+	cold_store(i, e, n);
+	cold_stats.demoted++;
+
+	if (entries > max_entries)
+		cold_expire(t);
+	while (entries > max_entries && nblocks > 0)
+		cold_drop(t);
+}
+
+/*
+ * Promote a page that sees another error. Returns 1 and its counts and
+ * approximate time of the last error when the page was in the cold tier.
+ */
+int cold_take(u64 pfn, unsigned *count, unsigned *total, time_t *t)
+{
+	struct cold_entry e[COLD_MAX + 1];
+	unsigned i;
+	time_t now = time(NULL);
+	int n, j;
+
+	if (nblocks == 0)
+		return 0;
+	i = cold_find(pfn);
+	if (pfn < blocks[i]->first)
+		return 0;
+	n = cold_decode(blocks[i], e);
+	for (j = 0; j < n && e[j].pfn < pfn; j++)
+		;
+	if (j == n || e[j].pfn != pfn)
+		return 0;
+	*count = e[j].count;
+	*total = e[j].total;
+	*t = (now / 3600 - hours_since(e[j].hour, now)) * 3600;
+	memmove(e + j, e + j + 1, (n - j - 1) * sizeof(*e));
+	entries--;
+	cold_store(i, e, n - 1);
+	cold_stats.promoted++;
+	return 1;
+}
+
+/* Drop all pages with frame numbers in [start, end] */
+unsigned long cold_forget(u64 start, u64 end)
+{
+	struct cold_entry e[COLD_MAX + 1];
+	unsigned long dropped = 0;
+	unsigned i;
+	int n, k, j;
+
+	for (i = 0; i < nblocks; i++) {
+		n = cold_decode(blocks[i], e);
+		for (j = k = 0; j < n; j++) {
+			if (e[j].pfn >= start && e[j].pfn <= end)
+				continue;
+			e[k++] = e[j];
+		}
+		if (k == n)
+			continue;
+		dropped += n - k;
+		entries -= n - k;
+		cold_store(i, e, k);
+		if (k == 0)
+			i--;	/* block i was removed, wraps to 0 */
+	}
+	return dropped;
+}
+
+void dump_cold(FILE *f)
+{
+	unsigned long bytes = 0;
+	unsigned i;
+
+	if (!max_entries)
+		return;
+	for (i = 0; i < nblocks; i++)
+		bytes += blocks[i]->len;
+	fprintf(f, "Cold page tier: %lu pages in %u blocks, %lu bytes encoded (max %lu pages)\n",
+		entries, nblocks, bytes, max_entries);
+	fprintf(f, "Cold page tier: demoted %lu promoted %lu expired %lu dropped %lu\n\n",
+		cold_stats.demoted, cold_stats.promoted, cold_stats.expired,
+		cold_stats.dropped);
+}
@@ -0,0 +1,5 @@
+void cold_setup(unsigned long max, unsigned agetime);
+void cold_put(u64 pfn, unsigned count, unsigned total, time_t t);
+int cold_take(u64 pfn, unsigned *count, unsigned *total, time_t *t);
+unsigned long cold_forget(u64 start, u64 end);
+void dump_cold(FILE *f);
@@ -0,0 +1,741 @@
+/* Memory errors of CXL memory expanders.
+
+   CXL memory devices do not report errors through the machine check
+   banks. The kernel turns their general media and DRAM event records
+   into the cxl_general_media and cxl_dram trace events. They are read
+   from a tracefs instance of our own and merged with the machine checks
+   as another ingest source. An error is accounted for its memory device
+   like a socket in the DIMM database, and for its host physical page
+   like any other memory error, so the page thresholds and offlining
+   apply to CXL memory too.
+
+   Older kernels only report the device physical address. It is
+   translated with the interleave of the CXL regions, read from sysfs
+   and cached until an address is not found.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "sysfs.h"
+#include "memdb.h"
+#include "page.h"
+#include "ingest.h"
+#include "eventloop.h"
+#include "msg.h"
+#include "trigger.h"
+#include "health.h"
+#include "candidate.h"
+#include "cxl.h"
+
+#define CXL_SYSFS "/sys"
+#define TRACEFS "/sys/kernel/tracing"
+#define TRACE_INSTANCE "mcelog"
+
+enum {
+	CXL_RING = 256,		/* events waiting in the ingest queue */
+	MAX_WAYS = 16,
+	MAX_MEMDEVS = 256,
+	RESCAN_INTERVAL = 60,	/* minimum seconds between region scans */
+	LINE_MAX_LEN = 4096,
+};
+
+enum cxl_kind { CXL_GENERAL_MEDIA, CXL_DRAM };
+
+static const char *kind_name[] = {
+	[CXL_GENERAL_MEDIA] = "general media",
+	[CXL_DRAM] = "DRAM",
+};
+
+/* validity flags of the event record */
+enum {
+	V_CHANNEL	= 1 << 0,
+	V_RANK		= 1 << 1,
+	V_DEVICE	= 1 << 2,
+	V_BANK_GROUP	= 1 << 3,
+	V_BANK		= 1 << 4,
+	V_ROW		= 1 << 5,
+	V_COLUMN	= 1 << 6,
+};
+
+static const struct {
+	const char *name;
+	unsigned flag;
+} valid_flags[] = {
+	{ "CHANNEL", V_CHANNEL },
+	{ "RANK", V_RANK },
+	{ "DEVICE", V_DEVICE },
+	{ "BANK GROUP", V_BANK_GROUP },
+	{ "BANK", V_BANK },
+	{ "ROW", V_ROW },
+	{ "COLUMN", V_COLUMN },
+	{}
+};
+
+#define HPA_INVALID (~0ULL)
+
+struct cxl_event {
+	enum cxl_kind kind;
+	char memdev[16];
+	char host[32];
+	char log[16];
+	char region[32];
+	char descriptor[64];
+	char type[32];
+	char transaction[32];
+	unsigned long long serial;
+	unsigned long long time_ns;
+	u64 dpa, hpa;
+	unsigned valid;
+	unsigned channel, rank, device;
+	unsigned bank_group, bank, row, column;
+	int uc;
+};
+
+struct cxl_target {
+	int memdev;
+	u64 dpa_base, dpa_size;
+};
+
+/* A CXL region: host physical memory interleaved over memory devices */
+struct cxl_region {
+	struct cxl_region *next;
+	char name[32];
+	u64 base, size;
+	unsigned ways, granularity;
+	struct cxl_target target[MAX_WAYS];
+};
+
+static char *sysfs_root = CXL_SYSFS;
+static struct cxl_region *regions;
+static time_t last_scan;
+static char *memdev_name[MAX_MEMDEVS];
+
+static struct ingest_source cxl_source = { .name = "cxl", .limit = CXL_RING / 2 };
+static struct cxl_event ring[CXL_RING];
+static int trace_fd = -1;
+static char linebuf[LINE_MAX_LEN];
+static size_t linelen;
+
+static struct {
+	unsigned long events[2];
+	unsigned long translated;
+	unsigned long unmapped;
+	unsigned long bad;
+} cxl_stats;
+
+static u64 cxl_field(char *base, char *name)
+{
+	char *val = read_field(base, name);
+	u64 v = strtoull(val, NULL, 0);
+
+	free(val);
+	return v;
+}
+
+/* The memory device an endpoint decoder belongs to: .../memN/endpointM/decoderM.K */
+static int decoder_memdev(char *devices, char *decoder)
+{
+	char *path, *real, *s;
+	int memdev = -1;
+
+	xasprintf(&path, "%s/%s", devices, decoder);
+	real = realpath(path, NULL);
+	free(path);
+	if (!real)
+		return -1;
+	for (s = strstr(real, "/mem"); s; s = strstr(s + 1, "/mem"))
+		if (sscanf(s, "/mem%d/", &memdev) == 1)
+			break;
+	free(real);
+	return memdev;
+}
+
+static void free_regions(void)
+{
+	struct cxl_region *r, *next;
+
+	for (r = regions; r; r = next) {
+		next = r->next;
+		free(r);
+	}
+	regions = NULL;
+}
+
+/* Read the regions and their targets from sysfs */
+static void scan_regions(void)
+{
+	char *devices, *base, *dec, name[32];
+	struct cxl_region *r;
+	struct dirent *de;
+	unsigned i;
+	DIR *d;
+
+	free_regions();
+	last_scan = time(NULL);
+	xasprintf(&devices, "%s/bus/cxl/devices", sysfs_root);
+	d = opendir(devices);
+	if (!d) {
+		free(devices);
+		return;
+	}
+	while ((de = readdir(d)) != NULL) {
+		if (strncmp(de->d_name, "region", 6))
+			continue;
+		r = xalloc(sizeof(struct cxl_region));
+		snprintf(r->name, sizeof(r->name), "%.31s", de->d_name);
+		xasprintf(&base, "%s/%s", devices, de->d_name);
+		r->base = cxl_field(base, "resource");
+		r->size = cxl_field(base, "size");
+		r->ways = cxl_field(base, "interleave_ways");
+		r->granularity = cxl_field(base, "interleave_granularity");
+		if (!r->size || !r->ways || r->ways > MAX_WAYS || !r->granularity) {
+			free(base);
+			free(r);
+			continue;
+		}
+		for (i = 0; i < r->ways; i++) {
+			snprintf(name, sizeof(name), "target%u", i);
+			dec = read_field(base, name);
+			r->target[i].memdev = *dec ? decoder_memdev(devices, dec) : -1;
+			if (*dec) {
+				char *dbase;
+
+				xasprintf(&dbase, "%s/%s", devices, dec);
+				r->target[i].dpa_base = cxl_field(dbase, "dpa_resource");
+				r->target[i].dpa_size = cxl_field(dbase, "dpa_size");
+				free(dbase);
+			}
+			free(dec);
+		}
+		free(base);
+		r->next = regions;
+		regions = r;
+	}
+	closedir(d);
+	free(devices);
+}
+
+/*
+ * Translate the device physical address of a memory device to the host
+ * physical address: the region interleaves granularity sized chunks
+ * over its targets in position order.
+ */
+static struct cxl_region *dpa_to_hpa(int memdev, u64 dpa, u64 *hpa)
+{
+	struct cxl_region *r;
+	struct cxl_target *t;
+	unsigned i;
+	u64 off;
+
+	for (r = regions; r; r = r->next) {
+		for (i = 0; i < r->ways; i++) {
+			t = &r->target[i];
+			if (t->memdev != memdev || dpa < t->dpa_base ||
+			    dpa >= t->dpa_base + t->dpa_size)
+				continue;
+			off = dpa - t->dpa_base;
+			*hpa = r->base + ((off / r->granularity) * r->ways + i) *
+				r->granularity + off % r->granularity;
+			return r;
+		}
+	}
+	return NULL;
+}
+
+static struct cxl_region *hpa_region(u64 hpa)
+{
+	struct cxl_region *r;
+
+	for (r = regions; r; r = r->next)
+		if (hpa >= r->base && hpa < r->base + r->size)
+			return r;
+	return NULL;
+}
+
+/* Look up a region, scanning sysfs again when the address is unknown */
+static struct cxl_region *find_region(struct cxl_event *e, int memdev)
+{
+	struct cxl_region *r;
+	int rescan;
+
+	for (rescan = 0; rescan < 2; rescan++) {
+		if (e->hpa != HPA_INVALID)
+			r = hpa_region(e->hpa);
+		else
+			r = dpa_to_hpa(memdev, e->dpa, &e->hpa);
+		if (r || time(NULL) - last_scan < RESCAN_INTERVAL)
+			return r;
+		scan_regions();
+	}
+	return NULL;
+}
+
+/* Copy the value after key= in a trace line, quoted with '' or up to a blank */
+static int trace_value(char *line, const char *key, char *buf, size_t len)
+{
+	size_t klen = strlen(key);
+	char *s, *end;
+
+	for (s = line; (s = strstr(s, key)) != NULL; s += klen) {
+		if ((s == line || s[-1] == ' ') && s[klen] == '=')
+			break;
+	}
+	if (!s)
+		return -1;
+	s += klen + 1;
+	if (*s == '\'') {
+		s++;
+		end = strchr(s, '\'');
+	} else {
+		end = s + strcspn(s, " \n");
+		/* serial=0: */
+		if (end > s && end[-1] == ':')
+			end--;
+	}
+	if (!end)
+		return -1;
+	snprintf(buf, len, "%.*s", (int)(end - s), s);
+	return 0;
+}
+
+static int trace_num(char *line, const char *key, int base, unsigned long long *v)
+{
+	char buf[32], *end;
+
+	if (trace_value(line, key, buf, sizeof(buf)) < 0 || !*buf)
+		return -1;
+	*v = strtoull(buf, &end, base);
+	return *end ? -1 : 0;
+}
+
+static unsigned trace_uint(char *line, const char *key, int base)
+{
+	unsigned long long v = 0;
+
+	trace_num(line, key, base, &v);
+	return v;
+}
+
+static unsigned parse_valid(char *s)
+{
+	unsigned valid = 0;
+	char *tok, *save;
+	int i;
+
+	for (tok = strtok_r(s, "|", &save); tok; tok = strtok_r(NULL, "|", &save))
+		for (i = 0; valid_flags[i].name; i++)
+			if (!strcmp(tok, valid_flags[i].name))
+				valid |= valid_flags[i].flag;
+	return valid;
+}
+
+/* Parse a line of trace output. Returns -1 when it is no CXL memory event */
+static int parse_event(char *line, struct cxl_event *e)
+{
+	char valid[128];
+	char *s;
+
+	memset(e, 0, sizeof(struct cxl_event));
+	if ((s = strstr(line, "cxl_general_media: ")) != NULL)
+		e->kind = CXL_GENERAL_MEDIA;
+	else if ((s = strstr(line, "cxl_dram: ")) != NULL)
+		e->kind = CXL_DRAM;
+	else
+		return -1;
+	s = strchr(s, ' ') + 1;
+	if (trace_value(s, "memdev", e->memdev, sizeof(e->memdev)) < 0 ||
+	    trace_num(s, "dpa", 16, &e->dpa) < 0) {
+		cxl_stats.bad++;
+		return -1;
+	}
+	trace_value(s, "host", e->host, sizeof(e->host));
+	trace_value(s, "log", e->log, sizeof(e->log));
+	trace_value(s, "region", e->region, sizeof(e->region));
+	trace_value(s, "descriptor", e->descriptor, sizeof(e->descriptor));
+	trace_value(s, "type", e->type, sizeof(e->type));
+	trace_value(s, "transaction_type", e->transaction, sizeof(e->transaction));
+	trace_num(s, "serial", 10, &e->serial);
+	trace_num(s, "time", 10, &e->time_ns);
+	if (trace_num(s, "hpa", 16, &e->hpa) < 0)
+		e->hpa = HPA_INVALID;
+	if (trace_value(s, "validity_flags", valid, sizeof(valid)) == 0)
+		e->valid = parse_valid(valid);
+	e->channel = trace_uint(s, "channel", 10);
+	e->rank = trace_uint(s, "rank", 10);
+	e->device = trace_uint(s, "device", 16);
+	e->bank_group = trace_uint(s, "bank_group", 10);
+	e->bank = trace_uint(s, "bank", 10);
+	e->row = trace_uint(s, "row", 10);
+	e->column = trace_uint(s, "column", 10);
+	e->uc = strstr(e->descriptor, "UNCORRECTABLE_EVENT") != NULL;
+	return 0;
+}
+
+static enum mem_source transaction_source(struct cxl_event *e)
+{
+	if (!strcmp(e->transaction, "Host Read"))
+		return MEM_SRC_READ;
+	if (!strcmp(e->transaction, "Internal Media Scrub") ||
+	    !strcmp(e->transaction, "Host Scan Media"))
+		return MEM_SRC_SCRUB;
+	return MEM_SRC_OTHER;
+}
+
+static time_t event_time(struct cxl_event *e)
+{
+	return e->time_ns ? (time_t)(e->time_ns / 1000000000ULL) : time(NULL);
+}
+
+/* The machine check record an event is ordered, deduplicated and accounted as */
+static void event_mce(struct cxl_event *e, int memdev, struct mce *m)
+{
+	memset(m, 0, sizeof(struct mce));
+	m->status = MCI_STATUS_VAL|MCI_STATUS_EN;
+	if (e->uc)
+		m->status |= MCI_STATUS_UC;
+	if (e->hpa != HPA_INVALID) {
+		m->status |= MCI_STATUS_ADDRV;
+		m->addr = e->hpa;
+	}
+	m->misc = e->dpa;
+	m->time = event_time(e);
+	/* without a device time stamp keep the order of the trace */
+	m->tsc = e->time_ns ? e->time_ns : cxl_source.records;
+	m->socketid = MEMDEV_SOCKET_BASE + memdev;
+	m->bank = e->kind;
+	m->finished = 1;
+}
+
+static void print_event(struct cxl_event *e)
+{
+	time_t t = event_time(e);
+	int n = 0;
+
+	Wprintf("CXL %s event: %s %s%s%s\n", kind_name[e->kind],
+		e->uc ? "uncorrected" : "corrected", e->type,
+		*e->transaction ? ", " : "", e->transaction);
+	Wprintf("MEMDEV %s HOST %s SERIAL %llu LOG %s\n", e->memdev, e->host,
+		e->serial, e->log);
+	if (e->time_ns)
+		Wprintf("TIME %lu %s", (unsigned long)t, ctime(&t));
+	n += Wprintf("DPA %llx ", e->dpa);
+	if (e->hpa != HPA_INVALID)
+		n += Wprintf("HPA %llx ", e->hpa);
+	if (*e->region)
+		n += Wprintf("REGION %s ", e->region);
+	if (e->valid & V_CHANNEL)
+		n += Wprintf("CHANNEL %u ", e->channel);
+	if (e->valid & V_RANK)
+		n += Wprintf("RANK %u ", e->rank);
+	if (e->valid & V_DEVICE)
+		n += Wprintf("DEVICE %u ", e->device);
+	if (e->valid & V_BANK_GROUP)
+		n += Wprintf("BANK_GROUP %u ", e->bank_group);
+	if (e->valid & V_BANK)
+		n += Wprintf("BANK %u ", e->bank);
+	if (e->valid & V_ROW)
+		n += Wprintf("ROW %u ", e->row);
+	if (e->valid & V_COLUMN)
+		n += Wprintf("COLUMN %u ", e->column);
+	if (n > 0)
+		Wprintf("\n");
+	if (strstr(e->descriptor, "THRESHOLD_EVENT"))
+		Wprintf("Device error threshold reached\n");
+}
+
+static int memdev_id(struct cxl_event *e)
+{
+	int id;
+
+	if (sscanf(e->memdev, "mem%d", &id) != 1 || id < 0 || id >= MAX_MEMDEVS)
+		return -1;
+	if (!memdev_name[id])
+		memdev_name[id] = xstrdup(e->memdev);
+	return id;
+}
+
+/*
+ * Find the host physical address of a parsed event and fill in its
+ * record. Returns -1 for events of unknown memory devices.
+ */
+static int prepare_event(struct cxl_event *e, struct mce *m)
+{
+	struct cxl_region *r;
+	int memdev, translate;
+
+	memdev = memdev_id(e);
+	if (memdev < 0) {
+		cxl_stats.bad++;
+		return -1;
+	}
+	cxl_stats.events[e->kind]++;
+	translate = e->hpa == HPA_INVALID;
+	r = find_region(e, memdev);
+	if (e->hpa == HPA_INVALID)
+		cxl_stats.unmapped++;
+	else if (translate)
+		cxl_stats.translated++;
+	if (r && !*e->region)
+		snprintf(e->region, sizeof(e->region), "%s", r->name);
+	event_mce(e, memdev, m);
+	return 0;
+}
+
+/* Account a CXL memory event */
+static void account_event(struct cxl_event *e, struct mce *m)
+{
+	int channel[2] = { -1, -1 }, dimm[2] = { -1, -1 };
+	int memdev = m->socketid - MEMDEV_SOCKET_BASE;
+	enum mem_source src = transaction_source(e);
+	struct timespec seen;
+
+	if (e->valid & V_CHANNEL)
+		channel[0] = e->channel;
+	memdb_name(m->socketid, -1, -1, memdev_name[memdev]);
+	if (channel[0] != -1)
+		memdb_name(m->socketid, channel[0], -1, memdev_name[memdev]);
+	memory_error(m, channel, dimm, 0, sizeof(struct mce), src);
+	if ((e->valid & (V_CHANNEL|V_RANK|V_DEVICE)) == (V_CHANNEL|V_RANK|V_DEVICE))
+		memdb_device_error(m, channel[0], -1, e->rank, e->device);
+	if (!e->uc)
+		health_ce(m->time);
+	if (!(m->status & MCI_STATUS_ADDRV))
+		return;
+	if (!e->uc) {
+		account_page_error(m, channel, dimm, src);
+	} else if (src == MEM_SRC_SCRUB) {
+		/* found before anybody consumed it */
+		clock_gettime(CLOCK_MONOTONIC, &seen);
+		page_offline_uc(m, &seen);
+		page_offline_run();
+	}
+}
+
+static void cxl_summary(const char *file)
+{
+	Lprintf("CXL events in %s: %lu general media, %lu DRAM, %lu translated, %lu unmapped, %lu unparseable\n",
+		file, cxl_stats.events[CXL_GENERAL_MEDIA], cxl_stats.events[CXL_DRAM],
+		cxl_stats.translated, cxl_stats.unmapped, cxl_stats.bad);
+}
+
+static void decode_action(const char *fmt, ...)
+{
+	va_list ap;
+	char *msg;
+
+	va_start(ap, fmt);
+	xvasprintf(&msg, fmt, ap);
+	va_end(ap);
+	Wprintf("Would %s\n", msg);
+	free(msg);
+}
+
+/*
+ * Decode captured trace output for --cxl. The events are accounted with
+ * the configured thresholds, but only reported what would be done.
+ */
+int cxl_decode(const char *file)
+{
+	char *line = NULL;
+	size_t linesz = 0;
+	struct cxl_event e;
+	struct mce m;
+	char *s;
+	FILE *f;
+
+	if ((s = config_string("cxl", "cxl-sysfs")) != NULL)
+		sysfs_root = s;
+	f = strcmp(file, "-") ? fopen(file, "r") : stdin;
+	if (!f) {
+		SYSERRprintf("Cannot open CXL trace `%s'", file);
+		return -1;
+	}
+	scan_regions();
+	dry_run = decode_action;
+	prefill_memdb(0);
+	page_setup();
+	while (getline(&line, &linesz, f) > 0) {
+		if (parse_event(line, &e) < 0 || prepare_event(&e, &m) < 0)
+			continue;
+		print_event(&e);
+		account_event(&e, &m);
+		flushlog();
+	}
+	dry_run = NULL;
+	free(line);
+	if (f != stdin)
+		fclose(f);
+	cxl_summary(file);
+	return 0;
+}
+
+/* An event released by ingest in time order */
+static void cxl_process(struct mce *m, int index)
+{
+	struct cxl_event *e = &ring[index % CXL_RING];
+
+	print_event(e);
+	account_event(e, m);
+	/* the candidate policy accounts the same event again */
+	if (candidate_begin(m)) {
+		account_event(e, m);
+		candidate_end();
+	}
+	flushlog();
+}
+
+static void trace_line(char *line)
+{
+	struct cxl_event *e = &ring[cxl_source.records % CXL_RING];
+	struct mce m;
+
+	if (parse_event(line, e) < 0 || prepare_event(e, &m) < 0)
+		return;
+	ingest_push(&cxl_source, &m, sizeof(struct mce), cxl_source.records);
+}
+
+/* Read the trace pipe until it is empty */
+static void trace_drain(struct ingest_source *src)
+{
+	char *s, *nl;
+	ssize_t n;
+
+	for (;;) {
+		n = read(trace_fd, linebuf + linelen, sizeof(linebuf) - 1 - linelen);
+		if (n <= 0)
+			break;
+		linelen += n;
+		linebuf[linelen] = 0;
+		for (s = linebuf; (nl = strchr(s, '\n')) != NULL; s = nl + 1) {
+			*nl = 0;
+			trace_line(s);
+		}
+		linelen -= s - linebuf;
+		memmove(linebuf, s, linelen);
+		/* a line longer than the buffer is no event of ours */
+		if (linelen == sizeof(linebuf) - 1)
+			linelen = 0;
+	}
+	if (n < 0 && errno != EAGAIN) {
+		SYSERRprintf("Cannot read CXL trace events");
+		return;
+	}
+	ingest_advance(src, time(NULL));
+}
+
+static void trace_read(struct pollfd *pfd, void *data)
+{
+	(void)pfd;
+	(void)data;
+	trace_drain(&cxl_source);
+	ingest_run();
+}
+
+static int trace_enable(char *instance, const char *event)
+{
+	char *fn;
+	int ret;
+
+	xasprintf(&fn, "%s/events/cxl/%s/enable", instance, event);
+	ret = sysfs_write(fn, "1");
+	free(fn);
+	return ret;
+}
+
+/*
+ * Enable the CXL memory events in a tracefs instance of our own, so that
+ * other users of the global trace buffer are not disturbed, and read
+ * them from its trace pipe in the event loop.
+ */
+void cxl_setup(void)
+{
+	char *tracefs = TRACEFS, *instance, *fn, *s;
+
+	if (config_bool("cxl", "cxl-enabled") == 0)
+		return;
+	if ((s = config_string("cxl", "cxl-sysfs")) != NULL)
+		sysfs_root = s;
+	if ((s = config_string("cxl", "tracefs")) != NULL)
+		tracefs = s;
+	xasprintf(&fn, "%s/events/cxl/cxl_general_media", tracefs);
+	if (access(fn, F_OK) < 0) {
+		free(fn);
+		return;
+	}
+	free(fn);
+
+	xasprintf(&instance, "%s/instances/" TRACE_INSTANCE, tracefs);
+	if (mkdir(instance, 0700) < 0 && errno != EEXIST) {
+		SYSERRprintf("Cannot create trace instance `%s'", instance);
+		goto out;
+	}
+	if (trace_enable(instance, "cxl_general_media") < 0 ||
+	    trace_enable(instance, "cxl_dram") < 0) {
+		SYSERRprintf("Cannot enable CXL trace events");
+		goto out;
+	}
+	xasprintf(&fn, "%s/trace_pipe", instance);
+	trace_fd = open(fn, O_RDONLY|O_NONBLOCK|O_CLOEXEC);
+	if (trace_fd < 0)
+		SYSERRprintf("Cannot open `%s'", fn);
+	free(fn);
+	if (trace_fd < 0)
+		goto out;
+
+	scan_regions();
+	cxl_source.process = cxl_process;
+	cxl_source.catch_up = trace_drain;
+	ingest_register(&cxl_source);
+	register_pollcb(trace_fd, POLLIN, trace_read, NULL);
+out:
+	free(instance);
+}
+
+void dump_cxl(FILE *f)
+{
+	struct cxl_region *r;
+	unsigned i;
+
+	if (trace_fd < 0) {
+		fprintf(f, "CXL memory events not traced\n");
+		return;
+	}
+	fprintf(f, "CXL events: %lu general media, %lu DRAM, %lu translated, %lu unmapped, %lu unparseable\n",
+		cxl_stats.events[CXL_GENERAL_MEDIA], cxl_stats.events[CXL_DRAM],
+		cxl_stats.translated, cxl_stats.unmapped, cxl_stats.bad);
+	for (r = regions; r; r = r->next) {
+		fprintf(f, "%s: %llx-%llx ways %u granularity %u targets", r->name,
+			r->base, r->base + r->size - 1, r->ways, r->granularity);
+		for (i = 0; i < r->ways; i++) {
+			if (r->target[i].memdev < 0)
+				fprintf(f, " ?");
+			else
+				fprintf(f, " mem%d", r->target[i].memdev);
+		}
+		fputc('\n', f);
+	}
+}
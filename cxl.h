@@ -0,0 +1,5 @@
+#include <stdio.h>
+
+int cxl_decode(const char *file);
+void cxl_setup(void);
+void dump_cxl(FILE *f);
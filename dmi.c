@@ -131,7 +131,7 @@ static void fill_handles(void)
 	int i;
 	struct dmi_entry *e, *next;
 	e = entries;
-	handle_to_entry = xalloc(sizeof(void *) * 0xffff);
+	handle_to_entry = xalloc_tag(MEM_DMI, sizeof(void *) * 0xffff);
 	for (i = 0; i < numentries; i++, e = next) { 
 		if (!check_entry(e, &next))
 			break;
@@ -173,7 +173,7 @@ static int append_sysfs_dmi_entry(unsigned char type, int instance)
 		} else if (nr > 0) {
 			while (l + nr > entrieslen) {
 				entrieslen += 4096;
-				entries = xrealloc(entries, entrieslen);
+				entries = xrealloc_tag(MEM_DMI, entries, entrieslen);
 			}
 			memcpy((char *)entries+l, buf, nr);
 			l += nr;
@@ -340,7 +340,7 @@ fill_entries:
 		goto out_mmap;
 	}
 	entrieslen = a->length;
-	entries = xalloc_nonzero(entrieslen);
+	entries = xalloc_nonzero_tag(MEM_DMI, entrieslen);
 	memcpy(entries, (char *)ebase+corr, entrieslen);
 	munmap(ebase, emapsize);
 	numentries = a->numentries;
@@ -501,7 +501,7 @@ dmi_collect(int type, int minsize, int *len)
 	struct dmi_entry **r; 
 	struct dmi_entry *e, *next;
 	int i, k;
-	r = xalloc(sizeof(struct dmi_entry *) * (numentries + 1));
+	r = xalloc_tag(MEM_DMI, sizeof(struct dmi_entry *) * (numentries + 1));
 	k = 0;
 	e = entries;
 	next = NULL;
@@ -693,7 +693,7 @@ void checkdmi(void)
 		do_dmi = dmi_sanity_check();
 }
 
-#define FREE(x) free(x), (x) = NULL
+#define FREE(x) xfree_tag(MEM_DMI, x), (x) = NULL
 
 void closedmi(void)
 {
@@ -25,7 +25,7 @@
 #include "mcelog.h"
 #include "eventloop.h"
 
-#define MAX_POLLFD 10
+#define MAX_POLLFD 32
 
 static int max_pollfd;
 
@@ -82,6 +82,16 @@ void unregister_pollcb(struct pollfd *pfd)
 	max_pollfd--;
 }
 
+/* Change the events waited for on fd, from outside its callback */
+void set_pollcb_events(int fd, int events)
+{
+	int i;
+
+	for (i = 0; i < max_pollfd; i++)
+		if (pollfds[i].fd == fd)
+			pollfds[i].events = events;
+}
+
 static void poll_callbacks(int n)
 {
 	int k;
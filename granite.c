@@ -22,6 +22,7 @@
 #include "bitfield.h"
 #include "granite.h"
 #include "memdb.h"
+#include "health.h"
 
 static char *upi_2[] = {
 	[0x00] = "UC Phy Initialization Failure (NumInit)",
@@ -224,9 +225,9 @@ static void granite_imc_misc(u64 status, u64 misc)
 	case 2: Wprintf("SDDC 125b 1LM\n"); break;
 	case 3: Wprintf("SDDC 96b 1LM\n"); break;
 	case 4: Wprintf("SDDC 96b 2LM\n"); break;
-	case 5: Wprintf("ADDDC 80b 1LM\n"); break;
-	case 6: Wprintf("ADDDC 80b 2LM\n"); break;
-	case 7: Wprintf("ADDDC 64b 1LM\n"); break;
+	case 5: Wprintf("ADDDC 80b 1LM\n"); health_adddc(); break;
+	case 6: Wprintf("ADDDC 80b 2LM\n"); health_adddc(); break;
+	case 7: Wprintf("ADDDC 64b 1LM\n"); health_adddc(); break;
 	case 8: Wprintf("9x4 61b 1LM\n"); break;
 	case 9: Wprintf("9x4 32b 1LM\n"); break;
 	case 10: Wprintf("9x4 32b 2LM\n"); break;
@@ -284,7 +285,7 @@ void granite_decode_model(int cputype, int bank, u64 status, u64 misc)
 void granite_memerr_misc(struct mce *m, int *channel, int *dimm)
 {
 	u64 status = m->status;
-	unsigned int chan;
+	unsigned int chan, mscod;
 
 	/* Check this is a memory error */
 	if (!test_prefix(7, status & 0xefff))
@@ -298,4 +299,15 @@ void granite_memerr_misc(struct mce *m, int *channel, int *dimm)
 		return;
 
 	channel[0] = m->bank - 13;
+
+	/* these MSCODs do not report the DRAM location in MISC */
+	mscod = EXTRACT(status, 16, 31);
+	if (mscod >= 0x800 && mscod <= 0x82f)
+		return;
+
+	/* failed DRAM device of a corrected error, by chip select */
+	if (EXTRACT(status, 59, 59) && EXTRACT(status, 33, 33) &&
+	    !EXTRACT(m->misc, 63, 63))
+		memdb_device_error(m, channel[0], dimm[0], EXTRACT(m->misc, 55, 57),
+				   EXTRACT(m->misc, 43, 48));
 }
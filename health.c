@@ -0,0 +1,313 @@
+/* Memory health of the node in a small state file.
+
+   The file gives schedulers and node agents the current memory health
+   without parsing logs or asking the daemon: an overall state (ok,
+   degraded or failing) and the facts it is based on. It is written to a
+   temporary file and renamed, so readers always see a complete file, and
+   only when its content changes, not for every error.
+
+   The state goes up immediately but only comes down again after the
+   node stayed better for recover-time, and a corrected error storm
+   ends only when the error rate stayed low for that time. So a flapping
+   error source does not make the state flap. Mirror failover and ADDDC
+   sparing count as long as they were seen within recover-time, or until
+   the counters of the DIMM that reported them are reset after a repair.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "eventloop.h"
+#include "memdb.h"
+#include "page.h"
+#include "health.h"
+#include "trigger.h"
+
+#define HEALTH_FILE "/var/run/mcelog-health"
+
+enum health_state { HEALTH_OK, HEALTH_DEGRADED, HEALTH_FAILING };
+
+static const char *health_name[] = {
+	[HEALTH_OK] = "ok",
+	[HEALTH_DEGRADED] = "degraded",
+	[HEALTH_FAILING] = "failing",
+};
+
+static char *health_file;
+static unsigned storm_threshold = 100;	/* corrected errors per minute */
+static unsigned storm_clear = 10;
+static unsigned recover_time = 600;	/* seconds */
+
+static enum health_state state;
+static time_t state_since;
+static time_t better_since;		/* wanted state below state since */
+static time_t failover, adddc;		/* last seen */
+static struct health_dimm {
+	int socketid, channel, dimm;	/* channel -1: unknown or several */
+} failover_dimm, adddc_dimm;
+static int storm;
+static time_t minute;			/* of the counted errors */
+static unsigned minute_errors;
+static time_t busy;			/* last minute with storm_clear errors */
+static char *written;
+static int timer_fd = -1;
+
+static void health_timer(struct pollfd *pfd, void *data)
+{
+	uint64_t expirations;
+
+	(void)data;
+	if (read(pfd->fd, &expirations, sizeof(expirations)) < 0)
+		return;
+	health_changed();
+}
+
+/* Check again at when */
+static void health_arm(time_t when)
+{
+	static int failed;
+	struct itimerspec its = {
+		.it_value = { .tv_sec = when },
+	};
+
+	if (timer_fd < 0 && !failed) {
+		timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK|TFD_CLOEXEC);
+		if (timer_fd < 0 ||
+		    register_pollcb(timer_fd, POLLIN, health_timer, NULL) < 0) {
+			SYSERRprintf("Cannot set up health timer, health only recovers on new events");
+			if (timer_fd >= 0)
+				close(timer_fd);
+			timer_fd = -1;
+			failed = 1;
+		}
+	}
+	if (timer_fd < 0)
+		return;
+	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		SYSERRprintf("Cannot arm health timer");
+}
+
+/* The earlier of two check times, 0 for none */
+static time_t earlier(time_t a, time_t b)
+{
+	if (!a || (b && b < a))
+		return b;
+	return a;
+}
+
+static void health_write(const char *s)
+{
+	char *tmp;
+	FILE *f;
+	int err;
+
+	xasprintf(&tmp, "%s.tmp", health_file);
+	f = fopen(tmp, "w");
+	if (!f) {
+		SYSERRprintf("Cannot open health file `%s'", tmp);
+		free(tmp);
+		return;
+	}
+	fputs(s, f);
+	err = ferror(f);
+	if (fclose(f) != 0 || err || rename(tmp, health_file) < 0) {
+		SYSERRprintf("Cannot write health file `%s'", health_file);
+		unlink(tmp);
+	}
+	free(tmp);
+	tmp = NULL;
+}
+
+/* Re-evaluate the health and update the file if anything changed */
+void health_changed(void)
+{
+	unsigned long pages = page_offlined_count();
+	int dimms = memdb_dimms_over();
+	time_t now = time(NULL);
+	enum health_state want;
+	time_t next = 0;
+	char *s;
+
+	if (!health_file || dry_run)
+		return;
+
+	if (storm && now - busy >= recover_time) {
+		Lprintf("Corrected memory error storm ended\n");
+		storm = 0;
+	}
+	if (failover && now - failover >= recover_time) {
+		Lprintf("No mirror failover for %us\n", recover_time);
+		failover = 0;
+	}
+	if (adddc && now - adddc >= recover_time) {
+		Lprintf("No ADDDC sparing for %us\n", recover_time);
+		adddc = 0;
+	}
+
+	if (storm || failover)
+		want = HEALTH_FAILING;
+	else if (pages || dimms || adddc)
+		want = HEALTH_DEGRADED;
+	else
+		want = HEALTH_OK;
+	if (want >= state) {
+		better_since = 0;
+	} else if (!better_since) {
+		better_since = now;
+	}
+	if (want > state || (better_since && now - better_since >= recover_time)) {
+		Lprintf("Memory health changed from %s to %s\n",
+			health_name[state], health_name[want]);
+		state = want;
+		state_since = now;
+		better_since = 0;
+	}
+	if (storm)
+		next = busy + recover_time;
+	if (better_since)
+		next = earlier(next, better_since + recover_time);
+	if (failover)
+		next = earlier(next, failover + recover_time);
+	if (adddc)
+		next = earlier(next, adddc + recover_time);
+	if (next)
+		health_arm(next);
+
+	xasprintf(&s, "state=%s\nsince=%lu\nofflined_pages=%lu\n"
+		  "dimms_over_threshold=%d\nmirror_failover=%s\nadddc=%s\n"
+		  "ce_storm=%s\n",
+		  health_name[state], (unsigned long)state_since, pages, dimms,
+		  failover ? "yes" : "no", adddc ? "yes" : "no",
+		  storm ? "yes" : "no");
+	if (written && !strcmp(s, written)) {
+		free(s);
+		return;
+	}
+	health_write(s);
+	free(written);
+	written = s;
+}
+
+/* A corrected memory error at t */
+void health_ce(time_t t)
+{
+	if (!health_file || dry_run)
+		return;
+	if (t / 60 != minute) {
+		minute = t / 60;
+		minute_errors = 0;
+	}
+	if (++minute_errors >= storm_clear)
+		busy = t;
+	if (!storm && minute_errors >= storm_threshold) {
+		Lprintf("Corrected memory error storm: %u errors in a minute\n",
+			minute_errors);
+		storm = 1;
+		health_changed();
+	}
+}
+
+/*
+ * Remember the DIMM of the memory error being decoded as the one that
+ * reported a failover or sparing. When another DIMM reported it too
+ * while it still counts, no single DIMM is.
+ */
+static void health_dimm(struct health_dimm *hd, int seen)
+{
+	int socketid, channel, dimm;
+
+	memdb_last_error(&socketid, &channel, &dimm);
+	if (seen && (socketid != hd->socketid || channel != hd->channel ||
+		     dimm != hd->dimm))
+		channel = -1;
+	hd->socketid = socketid;
+	hd->channel = channel;
+	hd->dimm = dimm;
+}
+
+static int health_dimm_is(struct health_dimm *hd, int socketid, int channel,
+			  int dimm)
+{
+	return hd->channel != -1 && hd->socketid == socketid &&
+		hd->channel == channel && hd->dimm == dimm;
+}
+
+/* A memory error was corrected by mirroring with channel failover */
+void health_failover(void)
+{
+	int seen = failover != 0;
+
+	if (dry_run)
+		return;
+	health_dimm(&failover_dimm, seen);
+	failover = time(NULL);
+	if (!seen)
+		health_changed();
+}
+
+/* A memory error was corrected in ADDDC mode, i.e. a DRAM device was spared */
+void health_adddc(void)
+{
+	int seen = adddc != 0;
+
+	if (dry_run)
+		return;
+	health_dimm(&adddc_dimm, seen);
+	adddc = time(NULL);
+	if (!seen)
+		health_changed();
+}
+
+/*
+ * The counters of a DIMM were reset after a repair. A failover or
+ * sparing reported by that DIMM alone is over.
+ */
+void health_reset(int socketid, int channel, int dimm)
+{
+	int changed = 0;
+
+	if (failover && health_dimm_is(&failover_dimm, socketid, channel, dimm)) {
+		failover = 0;
+		changed = 1;
+	}
+	if (adddc && health_dimm_is(&adddc_dimm, socketid, channel, dimm)) {
+		adddc = 0;
+		changed = 1;
+	}
+	if (changed)
+		health_changed();
+}
+
+void health_setup(void)
+{
+	char *s;
+
+	if (config_bool("health", "health-enabled") == 0)
+		return;
+	config_number("health", "storm-threshold", "%u", &storm_threshold);
+	config_number("health", "storm-clear", "%u", &storm_clear);
+	config_number("health", "recover-time", "%u", &recover_time);
+	s = config_string("health", "health-file");
+	health_file = s ? s : HEALTH_FILE;
+	state_since = time(NULL);
+	health_changed();
+}
@@ -0,0 +1,8 @@
+#include <time.h>
+
+void health_setup(void);
+void health_changed(void);
+void health_ce(time_t t);
+void health_failover(void);
+void health_adddc(void);
+void health_reset(int socketid, int channel, int dimm);
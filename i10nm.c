@@ -22,6 +22,7 @@
 #include "bitfield.h"
 #include "i10nm.h"
 #include "memdb.h"
+#include "health.h"
 
 /* Memory error was corrected by mirroring with channel failover */
 #define I10NM_MCI_MISC_FO      (1ULL<<63)
@@ -308,8 +309,8 @@ static void i10nm_imc_misc(u64 status, u64 misc)
 	switch (eccmode) {
 	case 0: Wprintf("SDDC memory mode\n"); break;
 	case 1: Wprintf("SDDC\n"); break;
-	case 4: Wprintf("ADDDC memory mode\n"); break;
-	case 5: Wprintf("ADDDC\n"); break;
+	case 4: Wprintf("ADDDC memory mode\n"); health_adddc(); break;
+	case 5: Wprintf("ADDDC\n"); health_adddc(); break;
 	case 8: Wprintf("DDRT read\n"); break;
 	default: Wprintf("unknown\n"); break;
 	}
@@ -486,4 +487,9 @@ void i10nm_memerr_misc(struct mce *m, int *channel, int *dimm)
 	}
 
 	channel[0] = imc * 3 + chan;
+
+	/* failed DRAM device of a corrected error on an IMC bank */
+	if (m->bank % 4 && (status & MCI_STATUS_MISCV) && !EXTRACT(m->misc, 63, 63))
+		memdb_device_error(m, channel[0], dimm[0], EXTRACT(m->misc, 56, 58),
+				   EXTRACT(m->misc, 46, 51));
 }
@@ -0,0 +1,293 @@
+/* Merge the machine check records of all sources into one ordered stream.
+
+   Every source (the kernel device, the firmware boot error records)
+   delivers records ordered by time, but the sources are read at
+   different times. Records are queued per source and released oldest
+   first once no open source can deliver an older one anymore, or when
+   they waited for the reorder window. A source that is behind is asked
+   to catch up first, so that an idle one does not hold back the others.
+   A source with too many queued records gets its oldest ones released
+   early, so that a slow or flooding source cannot hold back the others.
+   Records seen twice, e.g. from two sources, are only accounted once.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "eventloop.h"
+#include "ingest.h"
+
+enum {
+	DEDUP = 256,			/* released records checked for duplicates */
+	DEFAULT_LIMIT = 4096,
+};
+
+struct ingest_item {
+	struct ingest_item *next;
+	struct timespec queued;
+	unsigned recordlen;
+	int index;
+	struct mce m;
+};
+
+static ingest_cb ingest_emit;
+static struct ingest_source *sources;
+static unsigned reorder_window = 2;	/* seconds */
+static unsigned source_limit = DEFAULT_LIMIT;
+static u64 recent[DEDUP];
+static unsigned recent_next;
+static struct mce last;			/* time and tsc of the last released record */
+static unsigned long released;
+static int timer_fd = -1;
+
+void ingest_setup(ingest_cb cb)
+{
+	ingest_emit = cb;
+	config_number("ingest", "reorder-window", "%u", &reorder_window);
+	config_number("ingest", "source-queue-limit", "%u", &source_limit);
+}
+
+void ingest_register(struct ingest_source *s)
+{
+	if (!s->limit)
+		s->limit = source_limit;
+	s->next = sources;
+	sources = s;
+}
+
+static int mce_before(struct mce *a, struct mce *b)
+{
+	if (a->time != b->time)
+		return a->time < b->time;
+	return a->tsc < b->tsc;
+}
+
+static u64 mce_key(struct mce *m)
+{
+	u64 v[] = { m->status, m->addr, m->misc, m->time, m->tsc,
+		    m->bank, m->extcpu ? m->extcpu : m->cpu, m->apicid };
+	unsigned char *p = (unsigned char *)v;
+	u64 h = 0xcbf29ce484222325ULL;
+	unsigned i;
+
+	for (i = 0; i < sizeof(v); i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static int duplicate(struct mce *m)
+{
+	u64 key = mce_key(m);
+	unsigned i;
+
+	for (i = 0; i < DEDUP; i++)
+		if (recent[i] == key)
+			return 1;
+	recent[recent_next] = key;
+	recent_next = (recent_next + 1) % DEDUP;
+	return 0;
+}
+
+static unsigned long long elapsed_us(struct timespec *from, struct timespec *now)
+{
+	return (now->tv_sec - from->tv_sec) * 1000000ULL +
+		(now->tv_nsec - from->tv_nsec) / 1000;
+}
+
+static void release(struct ingest_source *s, struct timespec *now)
+{
+	struct ingest_item *it = s->head;
+	unsigned long long wait;
+	time_t age;
+
+	s->head = it->next;
+	if (!s->head)
+		s->tail = NULL;
+	s->queued--;
+
+	wait = elapsed_us(&it->queued, now);
+	s->wait_us += wait;
+	if (wait > s->max_wait_us)
+		s->max_wait_us = wait;
+	age = time(NULL) - it->m.time;
+	if (age > s->max_age)
+		s->max_age = age;
+
+	/* synthetic records must not disturb the checks of the real ones */
+	if (s->synthetic) {
+		ingest_emit(s, &it->m, it->recordlen, it->index);
+	} else if (duplicate(&it->m)) {
+		s->duplicates++;
+	} else {
+		if (released++ && mce_before(&it->m, &last))
+			s->late++;
+		else {
+			last.time = it->m.time;
+			last.tsc = it->m.tsc;
+		}
+		ingest_emit(s, &it->m, it->recordlen, it->index);
+	}
+	xfree_tag(MEM_OTHER, it);
+}
+
+void ingest_push(struct ingest_source *s, struct mce *m, unsigned recordlen,
+		 int index)
+{
+	struct ingest_item *it;
+	struct timespec now;
+
+	it = xalloc_tag(MEM_OTHER, sizeof(struct ingest_item));
+	memcpy(&it->m, m, recordlen < sizeof(struct mce) ? recordlen : sizeof(struct mce));
+	it->recordlen = recordlen;
+	it->index = index;
+	clock_gettime(CLOCK_MONOTONIC, &it->queued);
+	if (s->tail)
+		s->tail->next = it;
+	else
+		s->head = it;
+	s->tail = it;
+	s->queued++;
+	s->records++;
+
+	/* back-pressure: never hold more than the limit */
+	if (s->queued > s->limit) {
+		now = it->queued;
+		s->forced++;
+		release(s, &now);
+	}
+}
+
+/* The source will deliver no records older than watermark */
+void ingest_advance(struct ingest_source *s, time_t watermark)
+{
+	if (watermark > s->watermark)
+		s->watermark = watermark;
+}
+
+void ingest_close(struct ingest_source *s)
+{
+	s->closed = 1;
+	ingest_run();
+}
+
+int ingest_full(struct ingest_source *s)
+{
+	return s->queued >= s->limit;
+}
+
+static void ingest_timer(struct pollfd *pfd, void *data)
+{
+	uint64_t expirations;
+
+	(void)data;
+	if (read(pfd->fd, &expirations, sizeof(expirations)) < 0)
+		return;
+	ingest_run();
+}
+
+/* Run ingest_run again when the oldest waiting record reaches the window */
+static void ingest_arm(unsigned long long wait_us)
+{
+	unsigned long long left = reorder_window * 1000000ULL - wait_us;
+	struct itimerspec its = {
+		.it_value = { .tv_sec = left / 1000000, .tv_nsec = (left % 1000000) * 1000 },
+	};
+
+	if (timerfd_settime(timer_fd, 0, &its, NULL) < 0)
+		SYSERRprintf("Cannot arm record reorder timer");
+}
+
+/*
+ * Let records wait for the other sources from the event loop. Without
+ * the timer, e.g. when decoding once, they are released right away.
+ */
+void ingest_start(void)
+{
+	if (!reorder_window)
+		return;
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+	if (timer_fd < 0) {
+		SYSERRprintf("Cannot create record reorder timer");
+		return;
+	}
+	if (register_pollcb(timer_fd, POLLIN, ingest_timer, NULL) < 0) {
+		Eprintf("Cannot wait for records, they are not reordered\n");
+		close(timer_fd);
+		timer_fd = -1;
+	}
+}
+
+/* k-way merge: release the oldest head while no open source can be older */
+void ingest_run(void)
+{
+	struct ingest_source *s, *oldest;
+	struct timespec now;
+	unsigned long long wait;
+	int ready, caught_up = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (;;) {
+		oldest = NULL;
+		for (s = sources; s; s = s->next)
+			if (s->head && (!oldest || mce_before(&s->head->m, &oldest->head->m)))
+				oldest = s;
+		if (!oldest)
+			break;
+		ready = 1;
+		for (s = sources; s; s = s->next)
+			if (!s->closed && !s->synthetic &&
+			    s->watermark < (time_t)oldest->head->m.time)
+				ready = 0;
+		/* an idle source is only behind until it was asked */
+		if (!ready && !caught_up) {
+			caught_up = 1;
+			for (s = sources; s; s = s->next)
+				if (s->catch_up && !s->closed)
+					s->catch_up(s);
+			continue;
+		}
+		wait = elapsed_us(&oldest->head->queued, &now);
+		/* nothing would run us again without the timer */
+		if (!ready && wait < reorder_window * 1000000ULL && timer_fd >= 0) {
+			ingest_arm(wait);
+			break;
+		}
+		release(oldest, &now);
+	}
+}
+
+void dump_ingest(FILE *f)
+{
+	struct ingest_source *s;
+
+	fprintf(f, "Record sources (reorder window %us):\n", reorder_window);
+	for (s = sources; s; s = s->next) {
+		fprintf(f, "%s: records %lu queued %u duplicates %lu late %lu forced %lu%s\n",
+			s->name, s->records, s->queued, s->duplicates, s->late,
+			s->forced, s->closed ? " closed" : "");
+		if (s->records > s->queued)
+			fprintf(f, "%s: wait avg %lluus max %lluus, max age %lus\n",
+				s->name, s->wait_us / (s->records - s->queued),
+				s->max_wait_us,
+				(unsigned long)s->max_age);
+	}
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <time.h>
+
+struct mce;
+struct ingest_item;
+
+/* A stream of machine check records, ordered by time within itself */
+struct ingest_source {
+	const char *name;
+	unsigned limit;			/* queued records before they are forced out */
+	time_t watermark;		/* no older records will come from here */
+	int closed;
+	int synthetic;			/* made up records, never holds back others */
+	/* decodes the records of a source that are not machine checks */
+	void (*process)(struct mce *m, int index);
+	/* reads what is pending without blocking and advances the watermark */
+	void (*catch_up)(struct ingest_source *s);
+	unsigned queued;
+	struct ingest_item *head, *tail;
+	struct ingest_source *next;
+	/* statistics */
+	unsigned long records;
+	unsigned long duplicates;
+	unsigned long forced;		/* released early because the queue was full */
+	unsigned long late;		/* older than records already released */
+	unsigned long long wait_us, max_wait_us;
+	time_t max_age;
+};
+
+typedef void (*ingest_cb)(struct ingest_source *s, struct mce *m,
+			  unsigned recordlen, int index);
+
+void ingest_setup(ingest_cb cb);
+void ingest_register(struct ingest_source *s);
+void ingest_start(void);
+void ingest_push(struct ingest_source *s, struct mce *m, unsigned recordlen,
+		 int index);
+void ingest_advance(struct ingest_source *s, time_t watermark);
+void ingest_close(struct ingest_source *s);
+int ingest_full(struct ingest_source *s);
+void ingest_run(void);
+void dump_ingest(FILE *f);
@@ -0,0 +1,204 @@
+/* Synthetic machine check records for checking a running daemon.
+
+   The inject command queues made up records on their own ingest
+   source. They take the same path as the records from the kernel:
+   merged by ingest, decoded, accounted and acted on. While one is
+   processed the DIMM and page databases are switched to shadow copies
+   and actions are only logged, so a canary does not change what the
+   daemon knows about the real memory. The time each record spent in
+   every stage is reported back to the client.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "memdb.h"
+#include "page.h"
+#include "ingest.h"
+#include "trigger.h"
+#include "inject.h"
+
+static int injecting;
+
+static struct ingest_source inject_source = { .name = "inject", .synthetic = 1 };
+
+/* the stages between two points */
+static const char *stage_name[INJ_POINTS] = {
+	[INJ_RELEASED] = "queue",
+	[INJ_ACCOUNT] = "filter",
+	[INJ_FILTERED] = "account",
+	[INJ_DONE] = "decode",
+};
+
+static inject_cb done_cb;
+static void *done_data;
+static unsigned remaining, total;
+static unsigned long actions;
+static struct timespec pushed, point[INJ_POINTS];
+static unsigned long long sum_us[INJ_POINTS], max_us[INJ_POINTS];
+static unsigned long long sum_total_us, max_total_us;
+
+static unsigned long long elapsed_us(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) * 1000000ULL +
+		(to->tv_nsec - from->tv_nsec) / 1000;
+}
+
+/* A corrected memory read error on channel 0 of socket 0 */
+void inject_default(struct mce *m)
+{
+	memset(m, 0, sizeof(struct mce));
+	m->status = MCI_STATUS_VAL|MCI_STATUS_EN|MCI_STATUS_ADDRV|0x90;
+	m->addr = 0x100000000ULL;
+}
+
+/*
+ * Queue count copies of m. cb is called with the report once all were
+ * processed, which can be before this returns. Returns -1 while an
+ * earlier injection is still in flight.
+ */
+int inject_start(struct mce *m, unsigned count, inject_cb cb, void *data)
+{
+	struct mce r;
+	unsigned i;
+
+	if (remaining)
+		return -1;
+	done_cb = cb;
+	done_data = data;
+	remaining = total = count;
+	actions = 0;
+	sum_total_us = max_total_us = 0;
+	memset(sum_us, 0, sizeof(sum_us));
+	memset(max_us, 0, sizeof(max_us));
+
+	clock_gettime(CLOCK_MONOTONIC, &pushed);
+	for (i = 0; i < count; i++) {
+		r = *m;
+		if (!r.time)
+			r.time = time(NULL);
+		r.finished = 1;
+		ingest_push(&inject_source, &r, sizeof(struct mce), i);
+	}
+	ingest_run();
+	return 0;
+}
+
+/* The client went away, records in flight are still processed */
+void inject_cancel(void *data)
+{
+	if (done_data == data) {
+		done_cb = NULL;
+		done_data = NULL;
+	}
+}
+
+/* An action that was skipped because the record was synthetic */
+static void inject_action(const char *fmt, ...)
+{
+	va_list ap;
+	char *msg;
+
+	va_start(ap, fmt);
+	xvasprintf(&msg, fmt, ap);
+	va_end(ap);
+	Lprintf("Synthetic record: would %s\n", msg);
+	free(msg);
+	actions++;
+}
+
+/* A synthetic record was released: account it into the shadow */
+void inject_begin(void)
+{
+	memset(point, 0, sizeof(point));
+	injecting = 1;
+	inject_point(INJ_RELEASED);
+	dry_run = inject_action;
+	memdb_use(DB_SHADOW);
+	page_use(DB_SHADOW);
+}
+
+void inject_point(enum inject_point p)
+{
+	if (injecting)
+		clock_gettime(CLOCK_MONOTONIC, &point[p]);
+}
+
+static char *inject_report(void)
+{
+	char *report;
+	size_t len;
+	FILE *f;
+	int i;
+
+	f = open_memstream(&report, &len);
+	if (!f)
+		Enomem();
+	fprintf(f, "inject: %u records, %lu dry-run actions\n", total, actions);
+	for (i = 0; i < INJ_POINTS; i++)
+		fprintf(f, "%s: avg %lluus max %lluus\n", stage_name[i],
+			sum_us[i] / total, max_us[i]);
+	fprintf(f, "total: avg %lluus max %lluus\n", sum_total_us / total,
+		max_total_us);
+	fprintf(f, "done\n");
+	if (ferror(f) || fclose(f) != 0)
+		Enomem();
+	return report;
+}
+
+void inject_end(void)
+{
+	unsigned long long us;
+	char *report;
+	int i;
+
+	inject_point(INJ_DONE);
+	/* not a memory error: no accounting stage */
+	if (!point[INJ_ACCOUNT].tv_sec)
+		point[INJ_ACCOUNT] = point[INJ_FILTERED];
+	page_use(DB_LIVE);
+	memdb_use(DB_LIVE);
+	dry_run = NULL;
+	injecting = 0;
+
+	for (i = 0; i < INJ_POINTS; i++) {
+		us = elapsed_us(i ? &point[i - 1] : &pushed, &point[i]);
+		sum_us[i] += us;
+		if (us > max_us[i])
+			max_us[i] = us;
+	}
+	us = elapsed_us(&pushed, &point[INJ_DONE]);
+	sum_total_us += us;
+	if (us > max_total_us)
+		max_total_us = us;
+
+	if (--remaining || !done_cb)
+		return;
+	report = inject_report();
+	done_cb(done_data, report);
+	free(report);
+	done_cb = NULL;
+	done_data = NULL;
+}
+
+void inject_setup(void)
+{
+	ingest_register(&inject_source);
+}
@@ -0,0 +1,22 @@
+#include <stdio.h>
+
+struct mce;
+
+/* Points a synthetic record passes on its way through the daemon */
+enum inject_point {
+	INJ_RELEASED,		/* handed out by ingest */
+	INJ_ACCOUNT,		/* filtered, accounting starts */
+	INJ_FILTERED,		/* accounted and acted on */
+	INJ_DONE,		/* decoded and logged */
+	INJ_POINTS
+};
+
+typedef void (*inject_cb)(void *data, char *report);
+
+void inject_default(struct mce *m);
+int inject_start(struct mce *m, unsigned count, inject_cb cb, void *data);
+void inject_cancel(void *data);
+void inject_begin(void);
+void inject_point(enum inject_point p);
+void inject_end(void);
+void inject_setup(void);
@@ -29,6 +29,12 @@
 #include "i10nm.h"
 #include "sapphire.h"
 #include "granite.h"
+#include "interconnect.h"
+#include "power.h"
+#include "trace.h"
+#include "health.h"
+#include "inject.h"
+#include "trigger.h"
 
 int memory_error_support;
 
@@ -85,6 +91,8 @@ static int intel_memory_error(struct mce *m, unsigned recordlen)
 		unsigned corr_err_cnt = 0;
 		int channel[2] = { (mca & 0xf) == 0xf ? -1 : (int)(mca & 0xf), -1 };
 		int dimm[2] = { -1, -1 };
+		unsigned long long start;
+		enum mem_source src;
 
 		switch (cputype) { 
 		case CPU_NEHALEM:
@@ -122,27 +130,163 @@ static int intel_memory_error(struct mce *m, unsigned recordlen)
 
 		if (recordlen > offsetof(struct mce, mcgcap) && m->mcgcap & MCG_CMCI_P)
  			corr_err_cnt = EXTRACT(m->status, 38, 52);
-		memory_error(m, channel[0], dimm[0], corr_err_cnt, recordlen);
-		account_page_error(m, channel[0], dimm[0]);
-
-		/* 
-		 * When both DIMMs have a error account the error twice to the page.
-		 */
-		if (channel[1] != -1) {
-			memory_error(m, channel[1], dimm[1], corr_err_cnt, recordlen);
-			account_page_error(m, channel[1], dimm[1]);
-		}
+		/* channel[1] != -1: both DIMMs of a mirrored or lockstep pair */
+		src = intel_mem_source(m);
+		inject_point(INJ_ACCOUNT);
+		start = trace_begin();
+		memory_error(m, channel, dimm, corr_err_cnt, recordlen, src);
+		account_page_error(m, channel, dimm, src);
+		if (!(m->status & MCI_STATUS_UC))
+			health_ce(m->time ? (time_t)m->time : time(NULL));
+		trace_end("account", start, m->addr);
 
 		return 1;
 	}
 
+	memdb_forget_error();
 	return 0;
 }
 
+/* Patrol scrub, spare and read error bits of the memory controllers up to Skylake */
+static enum mem_source mc_bits_source(u64 status)
+{
+	if (EXTRACT(status, 19, 20))
+		return MEM_SRC_SCRUB;
+	if (EXTRACT(status, 21, 22))
+		return MEM_SRC_SPARE;
+	if (EXTRACT(status, 23, 23))
+		return MEM_SRC_READ;
+	return MEM_SRC_OTHER;
+}
+
+/* Patrol scrub, spare and read error codes of the memory controllers since Ice Lake */
+static enum mem_source imc_code_source(unsigned code)
+{
+	switch (code) {
+	case 0x08: case 0x10:
+		return MEM_SRC_SCRUB;
+	case 0x20: case 0x40:
+		return MEM_SRC_SPARE;
+	case 0x80: case 0xa0:
+		return MEM_SRC_READ;
+	default:
+		return MEM_SRC_OTHER;
+	}
+}
+
+/*
+ * What found a memory error: the model specific error code of the memory
+ * controller when known, else the architectural transaction type.
+ */
+enum mem_source intel_mem_source(struct mce *m)
+{
+	enum mem_source src = MEM_SRC_OTHER;
+	u32 mca = m->status & 0xefff;
+	u64 status = m->status;
+
+	switch (cputype) {
+	case CPU_SANDY_BRIDGE:
+	case CPU_SANDY_BRIDGE_EP:
+		if (m->bank >= 8 && m->bank <= 11)
+			src = mc_bits_source(status);
+		break;
+	case CPU_IVY_BRIDGE_EPEX:
+	case CPU_HASWELL_EPEX:
+	case CPU_BROADWELL_EPEX:
+		if (m->bank >= 9 && m->bank <= 16)
+			src = mc_bits_source(status);
+		break;
+	case CPU_BROADWELL_DE:
+		if (m->bank >= 9 && m->bank <= 10)
+			src = mc_bits_source(status);
+		break;
+	case CPU_SKYLAKE_XEON:
+		if (m->bank >= 13 && m->bank <= 18 && !EXTRACT(status, 27, 27))
+			src = mc_bits_source(status);
+		break;
+	case CPU_ICELAKE_XEON:
+	case CPU_ICELAKE_DE:
+	case CPU_TREMONT_D:
+		/* imc banks, not the M2M ones */
+		if (m->bank >= 13 && m->bank <= 27 && m->bank % 4 &&
+		    EXTRACT(status, 24, 31) == 0)
+			src = imc_code_source(EXTRACT(status, 16, 23));
+		break;
+	case CPU_SAPPHIRERAPIDS:
+	case CPU_EMERALDRAPIDS:
+		if (((m->bank >= 13 && m->bank <= 20) || m->bank == 30 ||
+		     m->bank == 31) && EXTRACT(status, 24, 31) == 0)
+			src = imc_code_source(EXTRACT(status, 16, 23));
+		break;
+	case CPU_GRANITERAPIDS:
+	case CPU_SIERRAFOREST:
+		if (m->bank >= 13 && m->bank <= 24)
+			src = imc_code_source(EXTRACT(status, 16, 31));
+		break;
+	default:
+		break;
+	}
+	if (src != MEM_SRC_OTHER)
+		return src;
+
+	switch ((mca >> 4) & 7) {
+	case 1:
+		return MEM_SRC_READ;
+	case 4:
+		return MEM_SRC_SCRUB;
+	default:
+		return MEM_SRC_OTHER;
+	}
+}
+
+/*
+ * Uncorrected memory error found by the patrol scrubber (UCNA or SRAO),
+ * i.e. before any consumer touched the poisoned line.
+ */
+int intel_uc_scrub_error(struct mce *m)
+{
+	u32 mca = m->status & 0xefff;
+	unsigned ar = (m->status >> 55) & 3;
+
+	if (!(m->status & MCI_STATUS_UC) || !(m->status & MCI_STATUS_ADDRV))
+		return 0;
+	/* UCNA or SRAO only. SRAR is handled by the kernel. */
+	if (ar != 0 && ar != 2)
+		return 0;
+	if (!test_prefix(7, mca))
+		return 0;
+
+	/* Architectural memory scrubbing transaction */
+	if (((mca >> 4) & 7) == 4)
+		return 1;
+
+	switch (cputype) {
+	case CPU_ICELAKE_XEON:
+	case CPU_ICELAKE_DE:
+	case CPU_TREMONT_D:
+	case CPU_SAPPHIRERAPIDS:
+	case CPU_EMERALDRAPIDS:
+		/* imc_0: uncorrected patrol scrub, imc_10: UC_PATSCRUB_MIRR2ND_ERR */
+		return EXTRACT(m->status, 16, 23) == 0x10 &&
+			(EXTRACT(m->status, 24, 31) == 0 ||
+			 EXTRACT(m->status, 24, 31) == 0x10);
+	case CPU_GRANITERAPIDS:
+	case CPU_SIERRAFOREST:
+		/* mcchan_0: UnCorr Patrol Scrub Error */
+		return m->bank >= 13 && m->bank <= 24 &&
+			EXTRACT(m->status, 16, 31) == 0x10;
+	default:
+		return 0;
+	}
+}
+
 /* No bugs known, but filter out memory errors if the user asked for it */
 int mce_filter_intel(struct mce *m, unsigned recordlen)
 {
+	/* the power and link state has no shadow, leave it alone */
+	if (!dry_run)
+		power_event(m);
 	if (intel_memory_error(m, recordlen) == 1) 
 		return !filter_memory_errors;
-	return 1;
+	return dry_run ? 1 : link_error(m);
 }
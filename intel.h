@@ -1,6 +1,8 @@
 enum cputype select_intel_cputype(int family, int model);
 int is_intel_cpu(int cpu);
 int mce_filter_intel(struct mce *m, unsigned recordlen);
+int intel_uc_scrub_error(struct mce *m);
+enum mem_source intel_mem_source(struct mce *m);
 void intel_cpu_init(enum cputype cpu);
 
 extern int memory_error_support;
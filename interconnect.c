@@ -0,0 +1,342 @@
+/* Track health of the UPI/QPI links between sockets.
+
+   Corrected link layer errors (retries, CRC, phy recovery) are counted
+   per socket and link in a leaky bucket. A link whose error rate exceeds
+   the threshold, or which sees an uncorrected link error, is reported
+   degraded once. It becomes healthy again after a quiet period, checked
+   on the next error of the link or from the idle expiry wheel.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "list.h"
+#include "config.h"
+#include "trigger.h"
+#include "leaky-bucket.h"
+#include "bitfield.h"
+#include "interconnect.h"
+#include "trace.h"
+#include "wheel.h"
+
+enum link_kind { LINK_RETRY, LINK_CRC, LINK_PHY, LINK_OTHER, MAX_LINK_KIND };
+
+static const char *link_kind_name[] = {
+	[LINK_RETRY] = "retry",
+	[LINK_CRC] = "crc",
+	[LINK_PHY] = "phy",
+	[LINK_OTHER] = "other",
+};
+
+static const char *link_kind_env[] = {
+	[LINK_RETRY] = "RETRYCOUNT",
+	[LINK_CRC] = "CRCCOUNT",
+	[LINK_PHY] = "PHYCOUNT",
+	[LINK_OTHER] = "OTHERCOUNT",
+};
+
+enum link_state { LINK_HEALTHY, LINK_DEGRADED };
+
+static const char *link_state_name[] = {
+	[LINK_HEALTHY] = "healthy",
+	[LINK_DEGRADED] = "degraded",
+};
+
+struct link {
+	struct link *next;
+	int socket;
+	int bank;
+	enum link_state state;
+	time_t since;		/* last state change */
+	time_t last;		/* last error */
+	unsigned transitions;
+	char queued;		/* on the wheel for recovery */
+	struct wheel_node wn;
+	unsigned long count[MAX_LINK_KIND];
+	unsigned long uc;
+	struct leaky_bucket bucket;
+};
+
+static struct link *links;
+static int link_tracking = 1;
+static int link_errors_log = 1;
+static unsigned link_recovery = 60*60;
+static struct bucket_conf link_conf;
+static struct trigger_template link_env;
+static struct wheel link_wheel;
+
+static time_t link_idle(struct wheel_node *n, time_t now);
+
+void link_setup(void)
+{
+	int n;
+
+	n = config_bool("link", "link-tracking-enabled");
+	if (n >= 0)
+		link_tracking = n;
+	n = config_bool("link", "link-errors-log");
+	if (n >= 0)
+		link_errors_log = n;
+	config_number("link", "link-recovery-time", "%u", &link_recovery);
+	config_trigger("link", "link-error", &link_conf);
+	trigger_template_init(&link_env);
+	trigger_template_add(&link_env, "AGETIME=%u", link_conf.agetime);
+	if (link_tracking) {
+		link_wheel.check = link_idle;
+		wheel_register(&link_wheel);
+	}
+}
+
+/* HSW/BDW QPI MSCOD */
+static enum link_kind qpi_kind(unsigned mscod)
+{
+	switch (mscod) {
+	case 0x11: case 0x30: case 0x31:
+		return LINK_CRC;
+	case 0x02: case 0x03:
+	case 0x20 ... 0x23:
+		return LINK_PHY;
+	default:
+		return LINK_OTHER;
+	}
+}
+
+/* SKX and later UPI MSCOD */
+static enum link_kind upi_kind(u64 status, unsigned mscod)
+{
+	/* Unexpected Retry.Ack/Retry.Req flit */
+	if (EXTRACT(status, 23, 24))
+		return LINK_RETRY;
+	switch (mscod) {
+	case 0x10: case 0x30: case 0x31: case 0x32:
+		return LINK_CRC;
+	case 0x00 ... 0x02:
+	case 0x20 ... 0x25:
+		return LINK_PHY;
+	default:
+		return LINK_OTHER;
+	}
+}
+
+/* Return 1 and the kind of error when the record comes from a link */
+static int link_classify(struct mce *m, enum link_kind *kind)
+{
+	u64 status = m->status;
+
+	switch (cputype) {
+	case CPU_NEHALEM:
+	case CPU_XEON75XX:
+		if (((status & 0xffff) >> 11) != 1)
+			return 0;
+		if (EXTRACT(status, 18, 18))
+			*kind = LINK_RETRY;
+		else if (EXTRACT(status, 16, 17))
+			*kind = LINK_CRC;
+		else
+			*kind = LINK_OTHER;
+		return 1;
+	case CPU_HASWELL_EPEX:
+	case CPU_BROADWELL_EPEX:
+		if (m->bank != 5 && m->bank != 20 && m->bank != 21)
+			return 0;
+		*kind = qpi_kind(EXTRACT(status, 16, 23));
+		return 1;
+	case CPU_SKYLAKE_XEON:
+		if (m->bank != 5 && m->bank != 12 && m->bank != 19)
+			return 0;
+		break;
+	case CPU_ICELAKE_XEON:
+	case CPU_ICELAKE_DE:
+	case CPU_TREMONT_D:
+		if (m->bank != 5 && m->bank != 7 && m->bank != 8)
+			return 0;
+		break;
+	case CPU_SAPPHIRERAPIDS:
+	case CPU_EMERALDRAPIDS:
+		if (m->bank != 5)
+			return 0;
+		break;
+	case CPU_GRANITERAPIDS:
+	case CPU_SIERRAFOREST:
+		if (m->bank != 5)
+			return 0;
+		*kind = upi_kind(0, EXTRACT(status, 16, 31));
+		return 1;
+	default:
+		return 0;
+	}
+	*kind = upi_kind(status, EXTRACT(status, 16, 21));
+	return 1;
+}
+
+static struct link *link_get(int socket, int bank)
+{
+	struct link *l;
+
+	for (l = links; l; l = l->next)
+		if (l->socket == socket && l->bank == bank)
+			return l;
+	l = xalloc(sizeof(struct link));
+	l->socket = socket;
+	l->bank = bank;
+	l->state = LINK_HEALTHY;
+	bucket_init(&l->bucket);
+	l->next = links;
+	links = l;
+	return l;
+}
+
+static void link_transition(struct link *l, enum link_state state, time_t t,
+			    char *reason)
+{
+	struct trigger_env env;
+	char *msg;
+	int i;
+	enum link_state prev = l->state;
+
+	l->state = state;
+	l->since = t;
+	l->transitions++;
+
+	xasprintf(&msg, "UPI/QPI link bank %d on socket %d %s: %s "
+		  "(retry %lu crc %lu phy %lu other %lu uncorrected %lu)",
+		  l->bank, l->socket, link_state_name[state], reason,
+		  l->count[LINK_RETRY], l->count[LINK_CRC],
+		  l->count[LINK_PHY], l->count[LINK_OTHER], l->uc);
+	Lprintf("%s\n", msg);
+
+	if (link_conf.trigger) {
+		trigger_env_init(&env, &link_env);
+		trigger_env_add(&env, "SOCKETID=%d", l->socket);
+		trigger_env_add(&env, "LINK=%d", l->bank);
+		trigger_env_add(&env, "STATE=%s", link_state_name[state]);
+		trigger_env_add(&env, "PREVSTATE=%s", link_state_name[prev]);
+		trigger_env_add(&env, "MESSAGE=%s", msg);
+		trigger_env_add(&env, "THRESHOLD=%s", reason);
+		for (i = 0; i < MAX_LINK_KIND; i++)
+			trigger_env_add(&env, "%s=%lu", link_kind_env[i],
+					l->count[i]);
+		trigger_env_add(&env, "UCCOUNT=%lu", l->uc);
+		if (t)
+			trigger_env_add(&env, "LASTEVENT=%lu", (unsigned long)t);
+
+		run_trigger(link_conf.trigger, NULL, trigger_env(&env), false,
+			    "link");
+	}
+	free(msg);
+	msg = NULL;
+}
+
+/* A degraded link turns healthy after a quiet period */
+static void link_recover(struct link *l, time_t now)
+{
+	char *reason;
+
+	if (l->state != LINK_DEGRADED || now - l->last < (time_t)link_recovery)
+		return;
+	xasprintf(&reason, "no errors for %lus",
+		  (unsigned long)(now - l->last));
+	link_transition(l, LINK_HEALTHY, now, reason);
+	free(reason);
+	reason = NULL;
+}
+
+static time_t link_idle(struct wheel_node *n, time_t now)
+{
+	struct link *l = container_of(n, struct link, wn);
+
+	link_recover(l, now);
+	if (l->state == LINK_DEGRADED)
+		return l->last + link_recovery;
+	l->queued = 0;
+	return 0;
+}
+
+/*
+ * Account a link error. Returns 0 when the record should not be logged
+ * individually, because the tracker reports the state of the link instead.
+ */
+int link_error(struct mce *m)
+{
+	enum link_kind kind;
+	struct link *l;
+	char *reason;
+	time_t t = m->time;
+	int uc = !!(m->status & MCI_STATUS_UC);
+
+	if (!link_tracking || !link_classify(m, &kind))
+		return 1;
+
+	l = link_get(m->socketid, m->bank);
+	if (!l->since)
+		l->since = t;
+	link_recover(l, t);
+	l->last = t;
+	l->count[kind]++;
+	if (uc)
+		l->uc++;
+
+	if (__bucket_account(&link_conf, &l->bucket, 1, t) || uc) {
+		trace_mark("link bucket overflow", m->status);
+		if (l->state == LINK_HEALTHY) {
+			if (uc)
+				xasprintf(&reason, "uncorrected %s error",
+					  link_kind_name[kind]);
+			else
+				reason = bucket_output(&link_conf, &l->bucket);
+			link_transition(l, LINK_DEGRADED, t, reason);
+			free(reason);
+			reason = NULL;
+		}
+		if (!l->queued) {
+			l->queued = 1;
+			wheel_add(&link_wheel, &l->wn, t + link_recovery);
+		}
+	}
+
+	return uc || link_errors_log;
+}
+
+void dump_links(FILE *f)
+{
+	struct link *l;
+	char *rate;
+	enum link_state state;
+	time_t since, now = time(NULL);
+
+	for (l = links; l; l = l->next) {
+		/* the wheel reports the recovery when its tick comes up */
+		state = l->state;
+		since = l->since;
+		if (state == LINK_DEGRADED &&
+		    now - l->last >= (time_t)link_recovery) {
+			state = LINK_HEALTHY;
+			since = l->last + link_recovery;
+		}
+		rate = bucket_output(&link_conf, &l->bucket);
+		fprintf(f, "Socket %d link bank %d: %s since %lu (%u transitions)\n",
+			l->socket, l->bank, link_state_name[state],
+			(unsigned long)since, l->transitions);
+		fprintf(f, "\tretry %lu crc %lu phy %lu other %lu uncorrected %lu\n",
+			l->count[LINK_RETRY], l->count[LINK_CRC],
+			l->count[LINK_PHY], l->count[LINK_OTHER], l->uc);
+		fprintf(f, "\trate \"%s\"\n", rate);
+		free(rate);
+		rate = NULL;
+	}
+}
@@ -0,0 +1,3 @@
+void link_setup(void);
+int link_error(struct mce *m);
+void dump_links(FILE *f);
@@ -20,6 +20,8 @@
 #define _GNU_SOURCE 1
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <asm/types.h>
 #include <asm/ioctls.h>
 #include <linux/limits.h>
@@ -56,6 +58,16 @@
 #include "msg.h"
 #include "yellow.h"
 #include "page.h"
+#include "interconnect.h"
+#include "power.h"
+#include "wire.h"
+#include "bert.h"
+#include "cxl.h"
+#include "ingest.h"
+#include "inject.h"
+#include "candidate.h"
+#include "trace.h"
+#include "health.h"
 #include "bus.h"
 #include "unknown.h"
 
@@ -81,6 +93,7 @@ static char pidfile_default[] = PID_FILE;
 static char logfile_default[] = LOG_FILE;
 static char *pidfile = pidfile_default;
 static char *logfile;
+static char *wirefile;
 static int debug_numerrors;
 int imc_log = -1;
 static int check_only = 0;
@@ -289,18 +302,59 @@ static enum cputype setup_cpuid(u32 cpuvendor, u32 cpuid)
 	}
 }
 
+/*
+ * Decoder state derived from the CPUID of a record. Mixed logs switch
+ * between a few of these, so keep them cached instead of re-detecting
+ * (and re-warning) on every record.
+ */
+struct cpu_context {
+	struct cpu_context *next;
+	u32 cpuvendor;
+	u32 cpuid;
+	enum cputype cputype;
+	int warned;
+};
+
+#define CPU_CONTEXT_HASH 32
+
+static struct cpu_context *cpu_contexts[CPU_CONTEXT_HASH];
+static struct cpu_context *last_context;
+
+static struct cpu_context *cpu_context(u32 cpuvendor, u32 cpuid)
+{
+	struct cpu_context *c = last_context;
+	unsigned h;
+
+	if (c && c->cpuid == cpuid && c->cpuvendor == cpuvendor)
+		return c;
+	h = (cpuid ^ (cpuid >> 12) ^ cpuvendor) % CPU_CONTEXT_HASH;
+	for (c = cpu_contexts[h]; c; c = c->next)
+		if (c->cpuid == cpuid && c->cpuvendor == cpuvendor)
+			break;
+	if (!c) {
+		c = xalloc(sizeof(struct cpu_context));
+		c->cpuvendor = cpuvendor;
+		c->cpuid = cpuid;
+		c->cputype = setup_cpuid(cpuvendor, cpuid);
+		c->next = cpu_contexts[h];
+		cpu_contexts[h] = c;
+	}
+	last_context = c;
+	return c;
+}
+
 static void mce_cpuid(struct mce *m)
 {
-	static int warned;
 	if (m->cpuid) {
-		enum cputype t = setup_cpuid(m->cpuvendor, m->cpuid);
+		struct cpu_context *c = cpu_context(m->cpuvendor, m->cpuid);
+		enum cputype t = c->cputype;
 		if (!cpu_forced)
 			cputype = t;
-		else if (t != cputype && t != CPU_GENERIC && !warned) {
+		else if (t != cputype && t != CPU_GENERIC && !c->warned) {
 			Eprintf("Forced cputype %s does not match cpu type %s from mcelog\n",
 				cputype_name[cputype],
 				cputype_name[t]);
-			warned = 1;
+			c->warned = 1;
 		}
 	} else if (cputype == CPU_GENERIC && !cpu_forced) { 
 		is_cpu_supported();
@@ -563,7 +617,9 @@ static void dump_mce_final(struct mce *m, char *symbol, int missing, int recordl
 	m->finished = 1;
 	if (m->cpuid)
 		mce_cpuid(m);
-	if (!dump_raw_ascii) {
+	if (wire_output)
+		wire_write(m, recordlen, WR_ASCII);
+	else if (!dump_raw_ascii) {
 		if (!dseen)
 			disclaimer();
 		dump_mce(m, recordlen);
@@ -797,7 +853,7 @@ restart:
 			s = skipspace(s);
 			if (*s && data)
 				dump_mce_final(&m, symbol, missing, recordlen, disclaimer_seen); 
-			if (!dump_raw_ascii)
+			if (!dump_raw_ascii && !wire_output)
 				Wprintf("%s", start);
 			if (*s && data)
 				goto restart;
@@ -878,6 +934,18 @@ void usage(void)
 "  mcelog [options] --ascii --file log\n"
 "Decode machine check ASCII output from kernel logs\n"
 "\n"
+"  mcelog [options] --read-wire [--file log]\n"
+"Decode machine check records in binary wire format\n"
+"\n"
+"  mcelog [options] --bert [--file table]\n"
+"Decode the boot error records of the firmware (default " BERT_FILE ")\n"
+"\n"
+"  mcelog [options] --cxl [--file trace]\n"
+"Decode and account CXL memory events in trace output (default stdin)\n"
+"\n"
+"  mcelog [options] --verify [--file manifest]\n"
+"Check decoding of a manifest of \"vendor:cpuid bank status misc expected\" lines\n"
+"\n"
 "Options:\n"  
 "--version           Show the version of mcelog and exit\n"
 "--cpu CPU           Set CPU type CPU to decode (see below for valid types)\n"
@@ -888,6 +956,9 @@ void usage(void)
 "--generic           Set the CPU to a generic version\n"
 "--cpumhz MHZ        Set CPU Mhz to decode time (output unreliable, not needed on new kernels)\n"
 "--raw		     (with --ascii) Dump in raw ASCII format for machine processing\n"
+"--wire              Output records in binary wire format for machine processing\n"
+"--wire-crc          Like --wire, with a checksum for every record\n"
+"--wire-file filename Append the wire format records to filename instead of stdout\n"
 "--daemon            Run in background waiting for events (needs newer kernel)\n"
 "--client            Query a currently running mcelog daemon for errors\n"
 "--ping              Send ping command to the currently running mcelog daemon\n"
@@ -918,6 +989,7 @@ void usage(void)
 
 enum options { 
 	O_LOGFILE = O_COMMON, 
+	O_WIRE_FILE,
 	O_K8,
 	O_P4,
 	O_GENERIC,
@@ -934,6 +1006,10 @@ enum options {
 	O_RAW,
 	O_DAEMON,
 	O_ASCII,
+	O_VERIFY,
+	O_READ_WIRE,
+	O_BERT,
+	O_CXL,
 	O_CLIENT,
 	O_PING,
 	O_VERSION,
@@ -971,6 +1047,13 @@ static struct option options[] = {
 	{ "no-syslog", 0, NULL, O_NO_SYSLOG },
 	{ "daemon", 0, NULL, O_DAEMON },
 	{ "ascii", 0, NULL, O_ASCII },
+	{ "verify", 0, NULL, O_VERIFY },
+	{ "read-wire", 0, NULL, O_READ_WIRE },
+	{ "bert", 0, NULL, O_BERT },
+	{ "cxl", 0, NULL, O_CXL },
+	{ "wire", 0, &wire_output, 1 },
+	{ "wire-crc", 0, &wire_output, 2 },
+	{ "wire-file", 1, NULL, O_WIRE_FILE },
 	{ "file", 1, NULL, O_FILE },
 	{ "version", 0, NULL, O_VERSION },
 	{ "config-file", 1, NULL, O_CONFIG_FILE },
@@ -996,6 +1079,9 @@ static int modifier(int opt)
 	case O_LOGFILE:
 		logfile = optarg;
 		break;
+	case O_WIRE_FILE:
+		wirefile = optarg;
+		break;
 	case O_K8:
 		cputype = CPU_K8;
 		cpu_forced = 1;
@@ -1111,6 +1197,21 @@ static int modifier(int opt)
 	return 1;
 } 
 
+/* Never mix the binary records with the log */
+static void wire_finish(void)
+{
+	if (!wire_output)
+		return;
+	if (wirefile) {
+		if (wire_open(wirefile) < 0)
+			exit(1);
+	} else if (daemon_mode) {
+		Eprintf("--wire in daemon mode needs --wire-file\n");
+		exit(1);
+	} else if (!logfile)
+		redirect_log(stderr);
+}
+
 static void modifier_finish(void)
 {
 	if(!foreground && daemon_mode && !logfile && !(syslog_opt & SYSLOG_LOG)) {
@@ -1125,6 +1226,7 @@ static void modifier_finish(void)
 				exit(1);
 		}
 	}			
+	wire_finish();
 }
 
 void argsleft(int ac, char **av)
@@ -1151,12 +1253,32 @@ static int combined_modifier(int opt)
 	return r;
 }
 
+/* Soft memory limits per subsystem, in KB */
+static void mem_limit_setup(void)
+{
+	char *name;
+	unsigned long kb;
+	int i;
+
+	for (i = 0; i < MAX_MEM_SUBSYS; i++) {
+		xasprintf(&name, "%s-limit", mem_subsys_name[i]);
+		if (config_number("memory", name, "%lu", &kb) == 0)
+			mem_set_limit(i, kb * 1024);
+		free(name);
+		name = NULL;
+	}
+}
+
 static void general_setup(void)
 {
 	trigger_setup();
 	yellow_setup();
 	bus_setup();
 	unknown_setup();
+	link_setup();
+	power_setup();
+	mem_limit_setup();
+	trace_setup();
 	config_cred("global", "run-credentials", &runcred);
 	if (config_bool("global", "filter-memory-errors") == 1)
 		filter_memory_errors = 1;
@@ -1179,22 +1301,90 @@ static void drop_cred(void)
 	}
 }
 
+static struct ingest_source dev_source = { .name = "device" };
+static struct ingest_source bert_source = { .name = "bert" };
+static int dev_fd = -1;
+static int finish;
+
+/* A record from the inject command, kept out of the output stream */
+static void process_synthetic(struct mce *mce, unsigned recordlen, int index)
+{
+	int ok;
+
+	inject_begin();
+	ok = mce_filter(mce, recordlen);
+	inject_point(INJ_FILTERED);
+	if (ok) {
+		Wprintf("MCE %d (synthetic)\n", index);
+		dump_mce(mce, recordlen);
+		flushlog();
+	}
+	inject_end();
+}
+
+/* Decode and account one record of the merged stream */
+static void process_record(struct ingest_source *s, struct mce *mce,
+			   unsigned recordlen, int index)
+{
+	unsigned long long start;
+	int ok;
+
+	if (s->synthetic) {
+		process_synthetic(mce, recordlen, index);
+		return;
+	}
+	if (s->process) {
+		s->process(mce, index);
+		return;
+	}
+	if (finish)
+		return;
+	if (numerrors > 0 && --numerrors == 0)
+		finish = 1;
+	ok = mce_filter(mce, recordlen);
+	/* the candidate policy accounts the same record again */
+	if (candidate_begin(mce)) {
+		if (mce_filter(mce, recordlen) && cputype >= CPU_INTEL)
+			intel_cache_threshold(mce, recordlen);
+		candidate_end();
+	}
+	if (!ok)
+		return;
+	start = trace_begin();
+	if (wire_output)
+		wire_write(mce, recordlen,
+			   cputype >= CPU_INTEL && intel_uc_scrub_error(mce) ?
+			   WR_SCRUB_UC : 0);
+	else if (!dump_raw_ascii) {
+		disclaimer();
+		Wprintf("MCE %d\n", index);
+		dump_mce(mce, recordlen);
+	} else
+		dump_mce_raw_ascii(mce, recordlen);
+	flushlog();
+	trace_end("decode", start, mce->status);
+}
+
 static void process(int fd, unsigned recordlen, unsigned loglen, char *buf)
 {	
 	int i; 
 	int len, count;
-	int finish = 0, flags;
+	int flags;
+	struct timespec seen;
+	unsigned long long start;
 
 	if (recordlen == 0) {
 		Wprintf("no data in mce record\n");
 		return;
 	}
 
+	start = trace_begin();
 	len = read(fd, buf, recordlen * loglen); 
 	if (len < 0) {
 		SYSERRprintf("mcelog read"); 
 		return;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &seen);
 
 	count = len / (int)recordlen;
 	if (count == (int)loglen) {
@@ -1203,21 +1393,22 @@ static void process(int fd, unsigned recordlen, unsigned loglen, char *buf)
 			Eprintf("Warning: MCE buffer is overflowed.\n");
 	}
 
-	for (i = 0; (i < count) && !finish; i++) {
+	/* Get poisoned pages found by the scrubber offline before anything else */
+	for (i = 0; i < count; i++) {
 		struct mce *mce = (struct mce *)(buf + i*recordlen);
 		mce_prepare(mce);
-		if (numerrors > 0 && --numerrors == 0)
-			finish = 1;
-		if (!mce_filter(mce, recordlen)) 
-			continue;
-		if (!dump_raw_ascii) {
-			disclaimer();
-			Wprintf("MCE %d\n", i);
-			dump_mce(mce, recordlen);
-		} else
-			dump_mce_raw_ascii(mce, recordlen);
-		flushlog();
+		if (cputype >= CPU_INTEL && intel_uc_scrub_error(mce))
+			page_offline_uc(mce, &seen);
 	}
+	page_offline_run();
+
+	/* Everything logged so far was read, newer records come later */
+	for (i = 0; i < count; i++)
+		ingest_push(&dev_source, (struct mce *)(buf + i*recordlen),
+			    recordlen, i);
+	ingest_advance(&dev_source, time(NULL));
+	ingest_run();
+	trace_end("read batch", start, count);
 
 	if (debug_numerrors && numerrors <= 0)
 		finish = 1;
@@ -1274,10 +1465,258 @@ static void ascii_command(int ac, char **av)
 		/* f closed by exit */
 	}
 	no_syslog();
+	wire_finish();
 	checkdmi();
 	decodefatal(f); 
 }
 
+/* One line of a --verify manifest */
+struct verify_entry {
+	unsigned line;
+	u32 cpuvendor, cpuid;
+	int bank;
+	u64 status, misc;
+	char *expect;
+};
+
+enum { VERIFY_PASS, VERIFY_FAIL, VERIFY_UNKNOWN };
+
+static int verify_one(struct verify_entry *e)
+{
+	struct mce m;
+	char *buf = NULL, *line, *save;
+	const char *prefix;
+	size_t len = 0;
+	FILE *f, *old;
+	unsigned code;
+	int ret;
+
+	memset(&m, 0, sizeof(struct mce));
+	m.cpuvendor = e->cpuvendor;
+	m.cpuid = e->cpuid;
+	m.bank = e->bank;
+	m.status = e->status;
+	m.misc = e->misc;
+	m.finished = 1;
+	mce_cpuid(&m);
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		Enomem();
+	old = redirect_log(f);
+	dump_mce(&m, sizeof(struct mce));
+	redirect_log(old);
+	if (fclose(f) != 0)
+		Enomem();
+
+	/* expected on the MCA line, bus errors with their own prefix */
+	code = e->status & 0xefff;
+	prefix = code >= 0x800 && code < 0x1000 ? "MCA: BUS error:" : "MCA:";
+	ret = VERIFY_FAIL;
+	for (line = strtok_r(buf, "\n", &save); line;
+	     line = strtok_r(NULL, "\n", &save)) {
+		if (strstr(line, prefix) && strstr(line, e->expect)) {
+			ret = VERIFY_PASS;
+			break;
+		}
+		if (strstr(line, "Unknown Error"))
+			ret = VERIFY_UNKNOWN;
+	}
+	free(buf);
+	buf = NULL;
+	return ret;
+}
+
+/*
+ * Decode a manifest of "vendor:cpuid bank status misc expected string"
+ * lines and check the MCA line of each decoding contains the expected
+ * string.
+ * The entries are split over one worker process per CPU.
+ */
+static void verify_command(int ac, char **av)
+{
+	FILE *f = stdin;
+	struct verify_entry *e = NULL;
+	unsigned n = 0, max = 0, line = 0, i;
+	char *s = NULL;
+	size_t slen = 0;
+	char *result;
+	long workers, w;
+	int count[3] = {};
+
+	argsleft(ac, av);
+	if (inputfile) {
+		f = fopen(inputfile, "r");
+		if (!f) {
+			fprintf(stderr, "Cannot open manifest `%s': %s\n",
+				inputfile, strerror(errno));
+			exit(1);
+		}
+		/* f closed by exit */
+	}
+	no_syslog();
+	checkdmi();
+
+	while (getline(&s, &slen, f) > 0) {
+		unsigned vendor, cpuid;
+		int bank, pos = 0;
+		unsigned long long status, misc;
+		char *expect;
+
+		line++;
+		if (*s == '#' || *s == '\n')
+			continue;
+		if (sscanf(s, "%u:%x %d %llx %llx %n", &vendor, &cpuid, &bank,
+			   &status, &misc, &pos) != 5 || !pos) {
+			Eprintf("manifest line %u unparseable\n", line);
+			continue;
+		}
+		expect = s + pos;
+		expect[strcspn(expect, "\n")] = 0;
+		if (n == max) {
+			max = max ? max * 2 : 1024;
+			e = xrealloc(e, max * sizeof(struct verify_entry));
+		}
+		e[n].line = line;
+		e[n].cpuvendor = vendor;
+		e[n].cpuid = cpuid;
+		e[n].bank = bank;
+		e[n].status = status;
+		e[n].misc = misc;
+		e[n].expect = xstrdup(expect);
+		n++;
+	}
+	free(s);
+	s = NULL;
+	if (n == 0)
+		exit(0);
+
+	result = mmap(NULL, n, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS,
+		      -1, 0);
+	if (result == MAP_FAILED)
+		Enomem();
+
+	workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers < 1)
+		workers = 1;
+	if (workers > (long)n)
+		workers = n;
+	fflush(NULL);
+	for (w = 0; w < workers; w++) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			SYSERRprintf("fork");
+			exit(1);
+		}
+		if (pid == 0) {
+			for (i = w; i < n; i += workers)
+				result[i] = verify_one(&e[i]);
+			_exit(0);
+		}
+	}
+	for (w = 0; w < workers; w++) {
+		int status;
+
+		if (wait(&status) < 0 || !WIFEXITED(status) ||
+		    WEXITSTATUS(status) != 0) {
+			Eprintf("verify worker failed\n");
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		count[(int)result[i]]++;
+		if (result[i] == VERIFY_PASS)
+			continue;
+		printf("%s line %u: %u:%#x bank %d status %#llx misc %#llx: expected `%s'\n",
+		       result[i] == VERIFY_FAIL ? "FAIL" : "UNKNOWN",
+		       e[i].line, e[i].cpuvendor, e[i].cpuid, e[i].bank,
+		       e[i].status, e[i].misc, e[i].expect);
+	}
+	printf("PASS: %d, FAIL: %d, UNKNOWN: %d\n", count[VERIFY_PASS],
+	       count[VERIFY_FAIL], count[VERIFY_UNKNOWN]);
+	exit(count[VERIFY_FAIL] || count[VERIFY_UNKNOWN] ? 1 : 0);
+}
+
+static void read_wire_record(struct mce *m, unsigned recordlen,
+			     struct wire_record *wr)
+{
+	m->finished = 1;
+	mce_cpuid(m);
+	if (wire_output)
+		wire_write(m, recordlen, wr->flags);
+	else if (dump_raw_ascii)
+		dump_mce_raw_ascii(m, recordlen);
+	else {
+		disclaimer();
+		dump_mce(m, recordlen);
+	}
+	flushlog();
+}
+
+static void read_wire_command(int ac, char **av)
+{
+	FILE *f = stdin;
+
+	argsleft(ac, av);
+	if (inputfile) {
+		f = fopen(inputfile, "r");
+		if (!f) {
+			fprintf(stderr, "Cannot open input file `%s': %s\n",
+				inputfile, strerror(errno));
+			exit(1);
+		}
+		/* f closed by exit */
+	}
+	no_syslog();
+	wire_finish();
+	checkdmi();
+	if (wire_read(f, read_wire_record) != 0)
+		exit(1);
+}
+
+static void bert_record(struct mce *m)
+{
+	mce_prepare(m);
+	if (!mce_filter(m, sizeof(struct mce)))
+		return;
+	if (wire_output)
+		wire_write(m, sizeof(struct mce), 0);
+	else if (dump_raw_ascii)
+		dump_mce_raw_ascii(m, sizeof(struct mce));
+	else {
+		disclaimer();
+		dump_mce(m, sizeof(struct mce));
+	}
+	flushlog();
+}
+
+static void bert_queue(struct mce *m)
+{
+	mce_prepare(m);
+	ingest_push(&bert_source, m, sizeof(struct mce), bert_source.records);
+}
+
+static void bert_command(int ac, char **av)
+{
+	argsleft(ac, av);
+	no_syslog();
+	wire_finish();
+	checkdmi();
+	if (bert_decode(inputfile ? inputfile : BERT_FILE, bert_record) < 0)
+		exit(1);
+}
+
+static void cxl_command(int ac, char **av)
+{
+	argsleft(ac, av);
+	no_syslog();
+	checkdmi();
+	if (cxl_decode(inputfile ? inputfile : "-") < 0)
+		exit(1);
+}
+
 static void client_command(int ac, char **av)
 {
 	argsleft(ac, av);
@@ -1285,6 +1724,11 @@ static void client_command(int ac, char **av)
 	// XXX modifiers
 	ask_server("dump all bios\n");
 	ask_server("pages\n");
+	ask_server("links\n");
+	ask_server("power\n");
+	ask_server("cgroups\n");
+	ask_server("memstats\n");
+	ask_server("ingest\n");
 }
 
 static void ping_command(int ac, char **av)
@@ -1308,9 +1752,24 @@ static void process_mcefd(struct pollfd *pfd, void *data)
 	process(pfd->fd, d->recordlen, d->loglen, d->buf);
 }
 
+/* Nothing to read means every record logged so far was read */
+static void dev_catch_up(struct ingest_source *s)
+{
+	struct pollfd pfd = { .fd = dev_fd, .events = POLLIN };
+
+	if (poll(&pfd, 1, 0) == 0)
+		ingest_advance(s, time(NULL));
+}
+
 static void handle_sigusr1(int sig)
 {
 	reopenlog();
+	wire_reopen();
+}
+
+static void handle_sigusr2(int sig)
+{
+	trace_flush();
 }
 
 int main(int ac, char **av) 
@@ -1330,6 +1789,17 @@ int main(int ac, char **av)
 		} else if (opt == O_ASCII) {
 			ascii_command(ac, av);
 			exit(0);
+		} else if (opt == O_VERIFY) {
+			verify_command(ac, av);
+		} else if (opt == O_READ_WIRE) {
+			read_wire_command(ac, av);
+			exit(0);
+		} else if (opt == O_BERT) {
+			bert_command(ac, av);
+			exit(0);
+		} else if (opt == O_CXL) {
+			cxl_command(ac, av);
+			exit(0);
 		} else if (opt == O_CLIENT) {
 			client_command(ac, av);
 			exit(0);
@@ -1376,6 +1846,8 @@ int main(int ac, char **av)
 	}
 	checkdmi();
 	general_setup();
+	ingest_setup(process_record);
+	ingest_register(&dev_source);
 		
 	fd = open(logfn, O_RDONLY); 
 	if (fd < 0) {
@@ -1398,19 +1870,32 @@ int main(int ac, char **av)
 			closedmi();
 		server_setup();
 		page_setup();
+		inject_setup();
+		candidate_setup();
+		ingest_start();
+		ingest_register(&bert_source);
+		bert_setup(bert_queue);
+		ingest_close(&bert_source);
+		cxl_setup();
+		health_setup();
 		if (imc_log)
 			set_imc_log(cputype);
 		drop_cred();
 		register_pollcb(fd, POLLIN, process_mcefd, &d);
+		dev_fd = fd;
+		dev_source.catch_up = dev_catch_up;
 		if (!foreground && daemon(0, need_stdout()) < 0)
 			err("daemon");
 		if (pidfile)
 			write_pidfile();
 		signal(SIGUSR1, handle_sigusr1);
 		event_signal(SIGUSR1);
+		signal(SIGUSR2, handle_sigusr2);
+		event_signal(SIGUSR2);
 		eventloop();
 	} else {
 		process(fd, d.recordlen, d.loglen, d.buf);
+		trace_flush();
 	}
 	trigger_wait();
 		
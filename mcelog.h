@@ -120,6 +120,22 @@ enum option_ranges {
 	O_DISKDB = 1000,
 };
 
+/* What found a memory error */
+enum mem_source {
+	MEM_SRC_OTHER,
+	MEM_SRC_READ,		/* demand read */
+	MEM_SRC_SCRUB,		/* patrol scrub */
+	MEM_SRC_SPARE,		/* copy to a spare device or rank */
+	MAX_MEM_SRC
+};
+
+/* Where memory errors are accounted */
+enum acct_db {
+	DB_LIVE,
+	DB_SHADOW,		/* synthetic records of the inject command */
+	DB_CANDIDATE,		/* candidate policy evaluated on real records */
+};
+
 enum syslog_opt { 
 	SYSLOG_LOG = (1 << 0),		/* normal decoding output to syslog */
 	SYSLOG_REMARK = (1 << 1), 	/* special warnings to syslog */
@@ -0,0 +1,199 @@
+/* Attribute failing pages to the memory cgroup that owns them.
+
+   /proc/kpagecgroup gives the inode of the memory cgroup charged for
+   every page frame. The inode is mapped to a cgroup path by scanning the
+   cgroup file system, so that a workload with failing memory can be
+   migrated instead of offlining the page or draining the node.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "memcg.h"
+
+#define KPAGECGROUP "/proc/kpagecgroup"
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+enum {
+	BATCH = 512,		/* page frames read from kpagecgroup at once */
+	BATCH_TTL = 10,		/* seconds a batch stays valid */
+	RESCAN_INTERVAL = 60,	/* minimum seconds between cgroup fs scans */
+	MEMCG_HASH = 64,
+};
+
+struct memcg {
+	struct memcg *next;
+	u64 ino;
+	char *path;		/* NULL until seen in the cgroup fs */
+	unsigned long errors;	/* corrected errors on owned pages */
+	unsigned long pages;	/* owned pages over the error threshold */
+	time_t last;
+};
+
+static int memcg_tracking = 1;
+static int kpagecgroup_fd = -1;
+static struct memcg *memcg_hash[MEMCG_HASH];
+static unsigned long memcg_reads, memcg_hits, memcg_scans;
+
+/* last batch read from kpagecgroup */
+static u64 batch[BATCH];
+static u64 batch_pfn = -1ULL;
+static time_t batch_time;
+static time_t last_scan;
+static size_t root_len;		/* of the hierarchy being scanned */
+
+void memcg_setup(void)
+{
+	int n;
+
+	n = config_bool("page", "memory-cgroup-tracking");
+	if (n >= 0)
+		memcg_tracking = n;
+	if (!memcg_tracking)
+		return;
+	kpagecgroup_fd = open(KPAGECGROUP, O_RDONLY|O_CLOEXEC);
+	if (kpagecgroup_fd < 0) {
+		Lprintf("Cannot open %s, no cgroup attribution of memory errors\n",
+			KPAGECGROUP);
+		memcg_tracking = 0;
+	}
+}
+
+static struct memcg *memcg_get(u64 ino, int insert)
+{
+	struct memcg *mc;
+	unsigned h = ino % MEMCG_HASH;
+
+	for (mc = memcg_hash[h]; mc; mc = mc->next)
+		if (mc->ino == ino)
+			return mc;
+	if (!insert)
+		return NULL;
+	mc = xalloc_tag(MEM_PAGE, sizeof(struct memcg));
+	mc->ino = ino;
+	mc->next = memcg_hash[h];
+	memcg_hash[h] = mc;
+	return mc;
+}
+
+static int scan_dir(const char *fpath, const struct stat *st, int flag,
+		    struct FTW *ftw)
+{
+	struct memcg *mc;
+	const char *p;
+
+	(void)ftw;
+	if (flag != FTW_D)
+		return 0;
+	mc = memcg_get(st->st_ino, 0);
+	if (!mc || mc->path)
+		return 0;
+	p = fpath + root_len;
+	mc->path = xstrdup_tag(MEM_PAGE, *p ? (char *)p : "/");
+	return 0;
+}
+
+/*
+ * Resolve the paths of all known inodes. Only inodes that already had an
+ * error are kept, so the cgroup fs is walked at most once per interval.
+ */
+static void memcg_scan(time_t now)
+{
+	char *root = CGROUP_ROOT "/memory";
+
+	if (now - last_scan < RESCAN_INTERVAL)
+		return;
+	last_scan = now;
+	memcg_scans++;
+	/* cgroup v2 has all controllers in one hierarchy */
+	if (access(CGROUP_ROOT "/cgroup.controllers", R_OK) == 0 ||
+	    access(root, R_OK) < 0)
+		root = CGROUP_ROOT;
+	root_len = strlen(root);
+	nftw(root, scan_dir, 16, FTW_PHYS|FTW_MOUNT);
+}
+
+/* Memory cgroup inode of a page, 0 if not charged. Returns -1 on error. */
+static int page_memcg_ino(u64 addr, time_t now, u64 *ino)
+{
+	u64 pfn = addr >> 12;
+	u64 start = pfn & ~(u64)(BATCH - 1);
+	ssize_t n;
+
+	if (start != batch_pfn || now - batch_time >= BATCH_TTL) {
+		memcg_reads++;
+		n = pread(kpagecgroup_fd, batch, sizeof(batch), start * sizeof(u64));
+		if (n < (ssize_t)((pfn - start + 1) * sizeof(u64))) {
+			batch_pfn = -1ULL;
+			return -1;
+		}
+		memset((char *)batch + n, 0, sizeof(batch) - n);
+		batch_pfn = start;
+		batch_time = now;
+	} else
+		memcg_hits++;
+	*ino = batch[pfn - start];
+	return 0;
+}
+
+/*
+ * Account a corrected error on the page at addr to its memory cgroup.
+ * threshold is set when the page crossed the error threshold.
+ * Returns the cgroup path, or NULL if the page is not charged to a
+ * cgroup or the owner is unknown.
+ */
+const char *memcg_error(u64 addr, time_t t, int threshold)
+{
+	struct memcg *mc;
+	time_t now = time(NULL);
+	u64 ino;
+
+	if (!memcg_tracking || page_memcg_ino(addr, now, &ino) < 0 || ino == 0)
+		return NULL;
+	mc = memcg_get(ino, 1);
+	mc->errors++;
+	if (threshold)
+		mc->pages++;
+	mc->last = t ? t : now;
+	if (!mc->path)
+		memcg_scan(now);
+	return mc->path;
+}
+
+void dump_memcg(FILE *f)
+{
+	struct memcg *mc;
+	int i;
+
+	if (!memcg_tracking)
+		return;
+	fprintf(f, "Memory cgroups with corrected errors:\n");
+	for (i = 0; i < MEMCG_HASH; i++)
+		for (mc = memcg_hash[i]; mc; mc = mc->next)
+			fprintf(f, "%s (inode %llu): errors %lu pages over threshold %lu last %lu\n",
+				mc->path ? mc->path : "?", mc->ino, mc->errors,
+				mc->pages, (unsigned long)mc->last);
+	fprintf(f, "kpagecgroup reads %lu cached %lu cgroup scans %lu\n",
+		memcg_reads, memcg_hits, memcg_scans);
+}
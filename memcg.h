@@ -0,0 +1,3 @@
+void memcg_setup(void);
+const char *memcg_error(u64 addr, time_t t, int threshold);
+void dump_memcg(FILE *f);
@@ -21,7 +21,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
 #include "mcelog.h"
 #include "memutil.h"
 #include "config.h"
@@ -31,6 +30,28 @@
 #include "trigger.h"
 #include "intel.h"
 #include "page.h"
+#include "list.h"
+#include "wheel.h"
+#include "trace.h"
+#include "health.h"
+
+enum {
+	DRAM_DEVICES = 64,	/* failed device fields are 6 bits */
+	DEVICE_MAX = 0xffff,
+};
+
+/*
+ * Corrected errors of one rank by failed DRAM device. top is kept as the
+ * device with the most errors, so accounting an error is O(1).
+ */
+struct rankdev {
+	struct rankdev *next;
+	int rank;
+	unsigned total;
+	unsigned short count[DRAM_DEVICES];
+	unsigned char top;
+	unsigned char reported;		/* top + 1 when reported */
+};
 
 struct memdimm {
 	struct memdimm *next;
@@ -39,27 +60,85 @@ struct memdimm {
 	int socketid;
 	struct err_type ce;
 	struct err_type uc;
+	unsigned src[MAX_MEM_SRC];	/* corrected errors by source */
 	char *name;
 	char *location;
 	struct dmi_memdev *memdev;
+	time_t last;			/* last error */
+	char queued;			/* on the idle expiry wheel */
+	char over;			/* crossed the DIMM threshold */
+	struct wheel_node wn;
+	struct rankdev *ranks;
 };
 
 struct err_triggers {
 	struct bucket_conf ce_bucket_conf;
 	struct bucket_conf uc_bucket_conf;
 	char *type;
+	unsigned weight[MAX_MEM_SRC];	/* of a corrected error by source */
+};
+
+const char *mem_source_name[MAX_MEM_SRC] = {
+	[MEM_SRC_OTHER] = "other",
+	[MEM_SRC_READ] = "read",
+	[MEM_SRC_SCRUB] = "scrub",
+	[MEM_SRC_SPARE] = "spare",
 };
 
 #define SHASH 17
 
-static int md_numdimms;
-static struct memdimm *md_dimms[SHASH];
+enum {
+	SHADOW_DIMMS = 64,	/* shadow entries before it starts over */
+};
+
+static struct err_triggers dimms = { .type = "DIMM", .weight = { 1, 1, 1, 1 } };
+static struct err_triggers sockets = { .type = "Socket", .weight = { 1, 1, 1, 1 } };
+static struct err_triggers candidate_dimms, candidate_sockets;
+
+/*
+ * A DIMM database with its thresholds: the live one, the shadow for
+ * synthetic records or the one of the candidate policy.
+ */
+struct memdb {
+	struct memdimm *dimms[SHASH];
+	int numdimms;
+	int over;
+	unsigned long reclaimed;
+	unsigned long cleared;		/* times it started over when full */
+	int limit;			/* entries, 0 for no limit */
+	enum mem_subsys mem;
+	struct err_triggers *dimm_triggers;
+	struct err_triggers *socket_triggers;
+};
 
-static struct err_triggers dimms = { .type = "DIMM" };
-static struct err_triggers sockets = { .type = "Socket" };
+static struct memdb live_db = {
+	.mem = MEM_DIMM, .dimm_triggers = &dimms, .socket_triggers = &sockets,
+};
+static struct memdb shadow_db = {
+	.limit = SHADOW_DIMMS, .mem = MEM_DIMM,
+	.dimm_triggers = &dimms, .socket_triggers = &sockets,
+};
+static struct memdb candidate_db = {
+	.mem = MEM_POLICY,
+	.dimm_triggers = &candidate_dimms, .socket_triggers = &candidate_sockets,
+};
+static struct memdb *mdb = &live_db;
+static struct memdb *dbs[] = {
+	[DB_LIVE] = &live_db,
+	[DB_SHADOW] = &shadow_db,
+	[DB_CANDIDATE] = &candidate_db,
+};
 
 static int memdb_enabled;
 static int sockdb_enabled;
+static int dimm_idle_expiry = 1;
+static struct wheel dimm_wheel;
+static unsigned device_share = 70;	/* percent */
+static unsigned device_min_errors = 16;
+static char *device_trigger;
+
+/* DIMM of the last memory error accounted live, channel -1 for none */
+static int last_socketid = -1, last_channel = -1, last_dimm = -1;
 
 #define FNV32_OFFSET 2166136261U
 #define FNV32_PRIME 0x01000193
@@ -83,7 +162,7 @@ struct memdimm *get_memdimm(int socketid, int channel, int dimm, int insert)
 	unsigned h;
 
 	h = dimmhash(socketid, dimm, channel);
-	for (md = md_dimms[h]; md; md = md->next) { 
+	for (md = mdb->dimms[h]; md; md = md->next) { 
 		if (md->socketid == socketid && 
 			md->channel == channel && 
 			md->dimm == dimm)
@@ -92,23 +171,84 @@ struct memdimm *get_memdimm(int socketid, int channel, int dimm, int insert)
 	if (md || !insert)
 		return md;
 
-	md = xalloc(sizeof(struct memdimm));
-	md->next = md_dimms[h];
-	md_dimms[h] = md;
+	md = xalloc_tag(mdb->mem, sizeof(struct memdimm));
+	md->next = mdb->dimms[h];
+	mdb->dimms[h] = md;
 	md->socketid = socketid;
 	md->channel = channel;
 	md->dimm = dimm;
-	md_numdimms++;
+	mdb->numdimms++;
 	bucket_init(&md->ce.bucket);
 	bucket_init(&md->uc.bucket);
 	return md;
 }
 
+/*
+ * Forget a DIMM that saw no error for the corrected error age time.
+ * DIMMs known from the BIOS, with uncorrected errors and the per socket
+ * entries are kept.
+ */
+static void free_ranks(struct memdimm *md, enum mem_subsys mem)
+{
+	struct rankdev *r, *next;
+
+	for (r = md->ranks; r; r = next) {
+		next = r->next;
+		xfree_tag(mem, r);
+	}
+	md->ranks = NULL;
+}
+
+static time_t memdimm_idle(struct wheel_node *n, time_t now)
+{
+	struct memdimm *md = container_of(n, struct memdimm, wn);
+	struct memdimm **p;
+	time_t expires;
+
+	if (md->name || md->location || md->memdev || md->uc.count || md->over ||
+	    (md->channel == -1 && md->dimm == -1)) {
+		md->queued = 0;
+		return 0;
+	}
+	expires = md->last + dimms.ce_bucket_conf.agetime;
+	if (expires > now)
+		return expires;
+	/* only live DIMMs are queued */
+	p = &live_db.dimms[dimmhash(md->socketid, md->dimm, md->channel)];
+	while (*p != md)
+		p = &(*p)->next;
+	*p = md->next;
+	live_db.numdimms--;
+	live_db.reclaimed++;
+	free_ranks(md, MEM_DIMM);
+	xfree_tag(MEM_DIMM, md);
+	return 0;
+}
+
+static void memdimm_over(struct memdimm *md, int over)
+{
+	if (md->over == over)
+		return;
+	md->over = over;
+	mdb->over += over ? 1 : -1;
+	health_changed();
+}
+
+static void memdimm_active(struct memdimm *md, time_t t)
+{
+	md->last = t;
+	if (dimm_idle_expiry && !md->queued && mdb == &live_db) {
+		md->queued = 1;
+		wheel_add(&dimm_wheel, &md->wn, t + dimms.ce_bucket_conf.agetime);
+	}
+}
+
 enum {
 	NUMLEN  = 30,
-	MAX_ENV = 20,
 };
 
+static struct trigger_template memdb_env;
+
 static char *number(char *buf, long num)
 {
 	snprintf(buf, NUMLEN, "%ld", num);
@@ -120,6 +260,12 @@ static char *format_location(struct memdimm *md)
 	char numbuf[NUMLEN], numbuf2[NUMLEN];
 	char *location;
 
+	if (md->socketid >= MEMDEV_SOCKET_BASE && md->location) {
+		xasprintf(&location, "MEMDEV:%s CHANNEL:%s",
+			md->location,
+			md->channel == -1 ? "?" : number(numbuf, md->channel));
+		return location;
+	}
 	xasprintf(&location, "SOCKET:%d CHANNEL:%s DIMM:%s [%s%s%s]",
 		md->socketid, 
 		md->channel == -1 ? "?" : number(numbuf, md->channel),
@@ -130,63 +276,77 @@ static char *format_location(struct memdimm *md)
 	return location;
 }
 
-/* Run a user defined trigger when a error threshold is crossed. */
-void memdb_trigger(char *msg, struct memdimm *md,  time_t t,
-		struct err_type *et, struct bucket_conf *bc, char *args[], bool sync,
-		const char* reporter)
+/*
+ * Run a user defined trigger when a error threshold is crossed.
+ * peer is the other DIMM of a mirrored or lockstep pair, or NULL.
+ * extra is a NULL terminated list of additional environment variables.
+ */
+void memdb_trigger_peer(char *msg, struct memdimm *md, struct memdimm *peer,
+		char **extra, time_t t, struct err_type *et, struct bucket_conf *bc, char *args[],
+		bool sync, const char* reporter)
 {
 	struct leaky_bucket *bucket = &et->bucket;
-	char *env[MAX_ENV]; 
-	int ei = 0;
-	int i;
+	struct trigger_env env;
 	char *location = format_location(md);
+	char *peer_location = peer ? format_location(peer) : NULL;
 	char *thresh = bucket_output(bc, bucket);
 	char *out;
 
 	xasprintf(&out, "%s: %s", msg, thresh);
-	if (bc->log) { 
+	if (dry_run)
+		dry_run("report %s at %s", out, location);
+	else if (bc->log) { 
 		Gprintf("%s\n", out); 
 		Gprintf("Location %s\n", location);
+		if (peer)
+			Gprintf("Peer location %s\n", peer_location);
 	}
 	if (bc->trigger == NULL)
 		goto out;
-	xasprintf(&env[ei++], "PATH=%s", getenv("PATH") ?: "/sbin:/usr/sbin:/bin:/usr/bin");
-	xasprintf(&env[ei++], "THRESHOLD=%s", thresh);
-	xasprintf(&env[ei++], "TOTALCOUNT=%lu", et->count);
-	xasprintf(&env[ei++], "LOCATION=%s", location);
+	trigger_env_init(&env, &memdb_env);
+	trigger_env_add(&env, "THRESHOLD=%s", thresh);
+	trigger_env_add(&env, "TOTALCOUNT=%u", et->count);
+	trigger_env_add(&env, "LOCATION=%s", location);
+	if (peer)
+		trigger_env_add(&env, "PEER_LOCATION=%s", peer_location);
 	if (md->location)
-		xasprintf(&env[ei++], "DMI_LOCATION=%s", md->location);
+		trigger_env_add(&env, "DMI_LOCATION=%s", md->location);
 	if (md->name)
-		xasprintf(&env[ei++], "DMI_NAME=%s", md->name);
+		trigger_env_add(&env, "DMI_NAME=%s", md->name);
 	if (md->dimm != -1)
-		xasprintf(&env[ei++], "DIMM=%d", md->dimm);
+		trigger_env_add(&env, "DIMM=%d", md->dimm);
 	if (md->channel != -1)
-		xasprintf(&env[ei++], "CHANNEL=%d", md->channel);
-	xasprintf(&env[ei++], "SOCKETID=%d", md->socketid);
-	xasprintf(&env[ei++], "CECOUNT=%lu", md->ce.count);
-	xasprintf(&env[ei++], "UCCOUNT=%lu", md->uc.count);
+		trigger_env_add(&env, "CHANNEL=%d", md->channel);
+	trigger_env_add(&env, "SOCKETID=%d", md->socketid);
+	trigger_env_add(&env, "CECOUNT=%u", md->ce.count);
+	trigger_env_add(&env, "UCCOUNT=%u", md->uc.count);
 	if (t)
-		xasprintf(&env[ei++], "LASTEVENT=%lu", t);
-	xasprintf(&env[ei++], "AGETIME=%u", bc->agetime);
+		trigger_env_add(&env, "LASTEVENT=%lu", t);
+	trigger_env_add(&env, "AGETIME=%u", bc->agetime);
 	// XXX human readable version of agetime
-	xasprintf(&env[ei++], "MESSAGE=%s", out);
-	xasprintf(&env[ei++], "THRESHOLD_COUNT=%d", bucket->count);
-	env[ei] = NULL;	
-	assert(ei < MAX_ENV);
-	run_trigger(bc->trigger, args, env, sync, reporter);
-	for (i = 0; i < ei; i++) {
-		free(env[i]);
-		env[i] = NULL;
-	}
+	trigger_env_add(&env, "MESSAGE=%s", out);
+	trigger_env_add(&env, "THRESHOLD_COUNT=%d", bucket->count);
+	for (; extra && *extra; extra++)
+		trigger_env_put(&env, *extra);
+	run_trigger(bc->trigger, args, trigger_env(&env), sync, reporter);
 out:
 	free(location);
 	location = NULL;
+	free(peer_location);
+	peer_location = NULL;
 	free(out);
 	out = NULL;
 	free(thresh);
 	thresh = NULL;
 }
 
+void memdb_trigger(char *msg, struct memdimm *md,  time_t t,
+		struct err_type *et, struct bucket_conf *bc, char *args[], bool sync,
+		const char* reporter)
+{
+	memdb_trigger_peer(msg, md, NULL, NULL, t, et, bc, args, sync, reporter);
+}
+
 /* 
  * Lost some errors. Assume they were CE. Only works for the sockets because
  * we have no clues where they are.
@@ -207,23 +367,43 @@ account_over(struct err_triggers *t, struct memdimm *md, struct mce *m, unsigned
 	}
 }
 
-static void 
-account_memdb(struct err_triggers *t, struct memdimm *md, struct mce *m, const char* reporter)
+/*
+ * Count the error. A corrected error adds the weight of its source to the
+ * bucket. Returns 1 when the threshold was crossed.
+ */
+static int account_memdb(struct err_triggers *t, struct memdimm *md, struct mce *m,
+			 enum mem_source src)
+{
+	if (m->status & MCI_STATUS_UC) { 
+		md->uc.count++;
+		return __bucket_account(&t->uc_bucket_conf, &md->uc.bucket, 1, m->time);
+	}
+	md->ce.count++;
+	md->src[src]++;
+	return __bucket_account(&t->ce_bucket_conf, &md->ce.bucket, t->weight[src],
+				m->time);
+}
+
+static void
+memdb_threshold(struct err_triggers *t, struct memdimm *md, struct memdimm *peer,
+		struct mce *m, const char* reporter)
 {
 	char *msg;
 
+	trace_mark("bucket overflow", m->status);
+	if (t == mdb->dimm_triggers) {
+		memdimm_over(md, 1);
+		if (peer)
+			memdimm_over(peer, 1);
+	}
 	xasprintf(&msg, "%scorrected %s memory error count exceeded threshold",
 		(m->status & MCI_STATUS_UC) ? "Un" : "", t->type);
-
-	if (m->status & MCI_STATUS_UC) { 
-		md->uc.count++;
-		if (__bucket_account(&t->uc_bucket_conf, &md->uc.bucket, 1, m->time))
-			memdb_trigger(msg, md, m->time, &md->uc, &t->uc_bucket_conf, NULL, false, reporter);
-	} else {
-		md->ce.count++;
-		if (__bucket_account(&t->ce_bucket_conf, &md->ce.bucket, 1, m->time))
-			memdb_trigger(msg, md, m->time, &md->ce, &t->ce_bucket_conf, NULL, false, reporter);
-	}
+	if (m->status & MCI_STATUS_UC)
+		memdb_trigger_peer(msg, md, peer, NULL, m->time, &md->uc, &t->uc_bucket_conf,
+				   NULL, false, reporter);
+	else
+		memdb_trigger_peer(msg, md, peer, NULL, m->time, &md->ce, &t->ce_bucket_conf,
+				   NULL, false, reporter);
 	free(msg);
 	msg = NULL;
 }
@@ -232,12 +412,17 @@ account_memdb(struct err_triggers *t, struct memdimm *md, struct mce *m, const c
  * A memory error happened, record it in the memdb database and run
  * triggers if needed.
  * ch/dimm == -1: Unspecified DIMM on the channel
+ * ch[1] != -1: the error is on a mirrored or lockstep pair. Both DIMMs
+ * are charged, but the socket only once, and a threshold crossed by
+ * both DIMMs on the same error runs a single trigger.
  */
-void memory_error(struct mce *m, int ch, int dimm, unsigned corr_err_cnt, 
-		unsigned recordlen)
+void memory_error(struct mce *m, int *ch, int *dimm, unsigned corr_err_cnt, 
+		unsigned recordlen, enum mem_source src)
 {
-	struct memdimm *md;
+	struct memdimm *md, *hit[2];
+	int i, nhit = 0;
 
+	memdb_forget_error();
 	if (recordlen < offsetof(struct mce, socketid)) { 
 		static int warned;
 		if (!warned) {
@@ -247,15 +432,137 @@ void memory_error(struct mce *m, int ch, int dimm, unsigned corr_err_cnt,
 		return;
 	}
 
-	if (memdb_enabled && (ch != -1 || dimm != -1)) {
-		md = get_memdimm(m->socketid, ch, dimm, 1);
-		account_memdb(&dimms, md, m, "memdb");
+	if (mdb == &live_db) {
+		last_socketid = m->socketid;
+		last_channel = ch[0];
+		last_dimm = dimm[0];
+	}
+
+	if (memdb_enabled) {
+		for (i = 0; i < 2; i++) {
+			if (i > 0 && ch[i] == -1)
+				break;
+			if (ch[i] == -1 && dimm[i] == -1)
+				continue;
+			md = get_memdimm(m->socketid, ch[i], dimm[i], 1);
+			memdimm_active(md, m->time ? (time_t)m->time : time(NULL));
+			if (account_memdb(mdb->dimm_triggers, md, m, src))
+				hit[nhit++] = md;
+		}
+		if (nhit)
+			memdb_threshold(mdb->dimm_triggers, hit[0], nhit > 1 ? hit[1] : NULL,
+					m, "memdb");
 	}
 
 	if (sockdb_enabled) {
 		md = get_memdimm(m->socketid, -1, -1, 1);
-		account_over(&sockets, md, m, corr_err_cnt, "sockdb_fallback");
-		account_memdb(&sockets, md, m, "sockdb_memdb");
+		account_over(mdb->socket_triggers, md, m, corr_err_cnt, "sockdb_fallback");
+		if (account_memdb(mdb->socket_triggers, md, m, src))
+			memdb_threshold(mdb->socket_triggers, md, NULL, m, "sockdb_memdb");
+	}
+}
+
+/*
+ * The DIMM of the memory error of the record being decoded, for the
+ * decoders that report how the error was corrected.
+ */
+void memdb_last_error(int *socketid, int *channel, int *dimm)
+{
+	*socketid = last_socketid;
+	*channel = last_channel;
+	*dimm = last_dimm;
+}
+
+/* The record being decoded is no memory error */
+void memdb_forget_error(void)
+{
+	if (mdb == &live_db)
+		last_channel = last_dimm = -1;
+}
+
+/* Most corrected errors of a rank come from one DRAM device */
+static void device_failing(struct memdimm *md, struct rankdev *r, time_t t)
+{
+	struct trigger_env env;
+	char *location = format_location(md);
+	char *msg;
+
+	xasprintf(&msg, "DRAM device %u of rank %d caused %u of %u corrected errors",
+		  r->top, r->rank, r->count[r->top], r->total);
+	if (dry_run) {
+		dry_run("report %s at %s", msg, location);
+	} else {
+		Gprintf("%s\n", msg);
+		Gprintf("Location %s\n", location);
+	}
+	if (device_trigger) {
+		trigger_env_init(&env, &memdb_env);
+		trigger_env_add(&env, "LOCATION=%s", location);
+		if (md->location)
+			trigger_env_add(&env, "DMI_LOCATION=%s", md->location);
+		if (md->name)
+			trigger_env_add(&env, "DMI_NAME=%s", md->name);
+		if (md->dimm != -1)
+			trigger_env_add(&env, "DIMM=%d", md->dimm);
+		trigger_env_add(&env, "CHANNEL=%d", md->channel);
+		trigger_env_add(&env, "SOCKETID=%d", md->socketid);
+		trigger_env_add(&env, "RANK=%d", r->rank);
+		trigger_env_add(&env, "DEVICE=%u", r->top);
+		trigger_env_add(&env, "DEVICE_COUNT=%u", r->count[r->top]);
+		trigger_env_add(&env, "TOTALCOUNT=%u", r->total);
+		if (t)
+			trigger_env_add(&env, "LASTEVENT=%lu", t);
+		trigger_env_add(&env, "MESSAGE=%s", msg);
+		run_trigger(device_trigger, NULL, trigger_env(&env), false,
+			    "memdb_device");
+	}
+	free(location);
+	location = NULL;
+	free(msg);
+	msg = NULL;
+}
+
+/*
+ * A corrected error on a rank was caused by a DRAM device, as reported
+ * in the failed device field. Reports the device once it caused
+ * device-share percent of the errors of the rank.
+ */
+void memdb_device_error(struct mce *m, int channel, int dimm, int rank,
+			unsigned device)
+{
+	struct memdimm *md;
+	struct rankdev *r;
+	int d;
+
+	if (!memdb_enabled || channel == -1 || device >= DRAM_DEVICES ||
+	    (m->status & MCI_STATUS_UC))
+		return;
+	md = get_memdimm(m->socketid, channel, dimm, 1);
+	for (r = md->ranks; r; r = r->next)
+		if (r->rank == rank)
+			break;
+	if (!r) {
+		r = xalloc_tag(mdb->mem, sizeof(struct rankdev));
+		r->rank = rank;
+		r->next = md->ranks;
+		md->ranks = r;
+	}
+	/* halve all counts before one overflows, this also ages old errors */
+	if (r->count[device] == DEVICE_MAX) {
+		r->total = 0;
+		for (d = 0; d < DRAM_DEVICES; d++) {
+			r->count[d] /= 2;
+			r->total += r->count[d];
+		}
+	}
+	r->count[device]++;
+	r->total++;
+	if (r->count[device] > r->count[r->top])
+		r->top = device;
+	if (r->reported != r->top + 1 && r->total >= device_min_errors &&
+	    r->count[r->top] * 100ULL >= (unsigned long long)device_share * r->total) {
+		r->reported = r->top + 1;
+		device_failing(md, r, m->time);
 	}
 }
 
@@ -307,10 +614,42 @@ static void dump_bios(struct memdimm *md, FILE *f)
 		fputc('\n', f);
 }
 
-static void dump_dimm(struct memdimm *md, FILE *f, enum printflags flags)
+static void dump_sources(unsigned *src, unsigned total, FILE *f)
+{
+	int i;
+
+	if (total == 0 || src[MEM_SRC_OTHER] == total)
+		return;
+	fprintf(f, "corrected errors by source:");
+	for (i = 0; i < MAX_MEM_SRC; i++)
+		fprintf(f, " %s %u", mem_source_name[i], src[i]);
+	fputc('\n', f);
+}
+
+static void dump_ranks(struct memdimm *md, FILE *f)
+{
+	struct rankdev *r;
+	int d;
+
+	for (r = md->ranks; r; r = r->next) {
+		fprintf(f, "rank %d corrected errors by DRAM device:", r->rank);
+		for (d = 0; d < DRAM_DEVICES; d++)
+			if (r->count[d])
+				fprintf(f, " %d:%u", d, r->count[d]);
+		if (r->reported)
+			fprintf(f, " (device %d failing)", r->reported - 1);
+		fputc('\n', f);
+	}
+}
+
+static void dump_dimm(struct memdb *db, struct memdimm *md, FILE *f,
+		      enum printflags flags)
 {
 	if (md->ce.count + md->uc.count > 0 || (flags & DUMP_ALL)) {
-		fprintf(f, "SOCKET %u", md->socketid);
+		if (md->socketid >= MEMDEV_SOCKET_BASE && md->location)
+			fprintf(f, "MEMDEV %s", md->location);
+		else
+			fprintf(f, "SOCKET %u", md->socketid);
 		if (md->channel == -1)
 			fprintf(f, " CHANNEL any");
 		else
@@ -324,34 +663,216 @@ static void dump_dimm(struct memdimm *md, FILE *f, enum printflags flags)
 		if (flags & DUMP_BIOS)
 			dump_bios(md, f);
 		dump_errtype("corrected memory errors", &md->ce, f, flags, 
-				&dimms.ce_bucket_conf);
+				&db->dimm_triggers->ce_bucket_conf);
 		dump_errtype("uncorrected memory errors", &md->uc, f, flags, 
-				&dimms.uc_bucket_conf);
+				&db->dimm_triggers->uc_bucket_conf);
+		dump_sources(md->src, md->ce.count, f);
+		dump_ranks(md, f);
 	}
 }
 
+/*
+ * Name the entry of a memory device that is not in the DMI tables, e.g.
+ * a CXL memory expander. location must stay valid, named entries are
+ * never reclaimed.
+ */
+void memdb_name(int socketid, int channel, int dimm, char *location)
+{
+	struct memdimm *md;
+
+	if (channel == -1 && dimm == -1 ? !sockdb_enabled : !memdb_enabled)
+		return;
+	md = get_memdimm(socketid, channel, dimm, 1);
+	if (!md->location)
+		md->location = location;
+}
+
+/* Take n out of a bucket, the part over the threshold first */
+static void bucket_drain(struct leaky_bucket *b, unsigned n)
+{
+	unsigned d = n < b->excess ? n : b->excess;
+
+	b->excess -= d;
+	n -= d;
+	b->count -= n < b->count ? n : b->count;
+}
+
+/* Has another DIMM of the socket of md errors? */
+static int socket_errors(struct memdimm *md)
+{
+	struct memdimm *o;
+	int i;
+
+	for (i = 0; i < SHASH; i++)
+		for (o = mdb->dimms[i]; o; o = o->next)
+			if (o != md && o->socketid == md->socketid &&
+			    (o->channel != -1 || o->dimm != -1) &&
+			    o->ce.count + o->uc.count > 0)
+				return 1;
+	return 0;
+}
+
+/* Take the errors of md off a counter of its socket */
+static void socket_drain(struct err_type *sock, struct err_type *e,
+			 struct bucket_conf *sbc, struct bucket_conf *dbc,
+			 int others)
+{
+	time_t now = bucket_time();
+
+	sock->count -= e->count < sock->count ? e->count : sock->count;
+	if (!others) {
+		bucket_init(&sock->bucket);
+		return;
+	}
+	bucket_age(sbc, &sock->bucket, now);
+	bucket_age(dbc, &e->bucket, now);
+	bucket_drain(&sock->bucket, e->bucket.count + e->bucket.excess);
+}
+
+/*
+ * Reset the counters of a DIMM, e.g. after it was replaced. Its errors
+ * are taken off the socket total and thresholds too, the socket starts
+ * over when no other DIMM of it has errors. Returns -1 for an unknown
+ * DIMM.
+ */
+int memdb_reset(int socketid, int channel, int dimm)
+{
+	struct memdimm *md, *sock;
+	int others, i;
+
+	md = get_memdimm(socketid, channel, dimm, 0);
+	if (!md)
+		return -1;
+	sock = get_memdimm(socketid, -1, -1, 0);
+	if (sock && sock != md) {
+		others = socket_errors(md);
+		socket_drain(&sock->ce, &md->ce, &mdb->socket_triggers->ce_bucket_conf,
+			     &mdb->dimm_triggers->ce_bucket_conf, others);
+		socket_drain(&sock->uc, &md->uc, &mdb->socket_triggers->uc_bucket_conf,
+			     &mdb->dimm_triggers->uc_bucket_conf, others);
+		for (i = 0; i < MAX_MEM_SRC; i++)
+			sock->src[i] -= md->src[i] < sock->src[i] ? md->src[i] : sock->src[i];
+	}
+	md->ce.count = 0;
+	md->uc.count = 0;
+	memset(md->src, 0, sizeof(md->src));
+	bucket_init(&md->ce.bucket);
+	bucket_init(&md->uc.bucket);
+	memdimm_over(md, 0);
+	free_ranks(md, MEM_DIMM);
+	health_reset(socketid, channel, dimm);
+	return 0;
+}
+
+int memdb_dimms_over(void)
+{
+	return live_db.over;
+}
+
+static void memdb_clear(struct memdb *db)
+{
+	struct memdimm *md, *next;
+	int i;
+
+	for (i = 0; i < SHASH; i++) {
+		for (md = db->dimms[i]; md; md = next) {
+			next = md->next;
+			free_ranks(md, db->mem);
+			xfree_tag(db->mem, md);
+		}
+		db->dimms[i] = NULL;
+	}
+	db->numdimms = 0;
+	db->over = 0;
+	db->cleared++;
+}
+
+/*
+ * Account memory errors in another database than the live one, until
+ * switched back. A database with a limit starts over when it is full.
+ */
+void memdb_use(enum acct_db db)
+{
+	mdb = dbs[db];
+	if (mdb->limit && mdb->numdimms >= mdb->limit)
+		memdb_clear(mdb);
+}
+
+int memdb_numdimms(enum acct_db db)
+{
+	return dbs[db]->numdimms;
+}
+
 /* Sort and dump DIMMs */
-void dump_memory_errors(FILE *f, enum printflags flags)
+static void dump_memdb(struct memdb *db, FILE *f, enum printflags flags)
 {
 	int i, k;
 	struct memdimm *md, **da;
 
-	da = xalloc(sizeof(void *) * md_numdimms);
+	da = xalloc(sizeof(void *) * db->numdimms);
 	k = 0;
 	for (i = 0; i < SHASH; i++) {
-		for (md = md_dimms[i]; md; md = md->next)
+		for (md = db->dimms[i]; md; md = md->next)
 			da[k++] = md;
 	}
-	qsort(da, md_numdimms, sizeof(void *), cmp_dimm);
-	for (i = 0; i < md_numdimms; i++)  {
+	qsort(da, db->numdimms, sizeof(void *), cmp_dimm);
+	for (i = 0; i < db->numdimms; i++)  {
 		if (i > 0)  
 			fputc('\n', f);
 		else
 			fprintf(f, "Memory errors\n");
-		dump_dimm(da[i], f, flags);
+		dump_dimm(db, da[i], f, flags);
 	}
 	free(da);
 	da = NULL;
+	if (db->reclaimed)
+		fprintf(f, "\nIdle DIMM entries reclaimed: %lu\n", db->reclaimed);
+	if (db->cleared)
+		fprintf(f, "\nStarted over when full: %lu times\n", db->cleared);
+}
+
+void dump_memory_errors(FILE *f, enum printflags flags)
+{
+	dump_memdb(&live_db, f, flags);
+}
+
+void dump_memory_errors_db(enum acct_db db, FILE *f, enum printflags flags)
+{
+	dump_memdb(dbs[db], f, flags);
+}
+
+/*
+ * Read base-weight-read etc.: how much a corrected error found by the
+ * source counts against the threshold. Weights that are not set are
+ * left alone, they start out as 1.
+ */
+void config_weights(const char *header, const char *base, unsigned *weight)
+{
+	char *name;
+	int i;
+
+	for (i = 0; i < MAX_MEM_SRC; i++) {
+		xasprintf(&name, "%s-weight-%s", base, mem_source_name[i]);
+		config_number(header, name, "%u", &weight[i]);
+		free(name);
+		name = NULL;
+	}
+}
+
+/* Thresholds of the candidate policy, the live ones where not set */
+void memdb_candidate_config(int limit)
+{
+	candidate_dimms = dimms;
+	config_trigger("candidate-dimm", "ce-error", &candidate_dimms.ce_bucket_conf);
+	config_trigger("candidate-dimm", "uc-error", &candidate_dimms.uc_bucket_conf);
+	config_weights("candidate-dimm", "ce-error", candidate_dimms.weight);
+
+	candidate_sockets = sockets;
+	config_trigger("candidate-socket", "mem-ce-error", &candidate_sockets.ce_bucket_conf);
+	config_trigger("candidate-socket", "mem-uc-error", &candidate_sockets.uc_bucket_conf);
+	config_weights("candidate-socket", "mem-ce-error", candidate_sockets.weight);
+
+	candidate_db.limit = limit;
 }
 
 void memdb_config(void)
@@ -366,6 +887,7 @@ void memdb_config(void)
 
 	config_trigger("dimm", "ce-error", &dimms.ce_bucket_conf);
 	config_trigger("dimm", "uc-error", &dimms.uc_bucket_conf);
+	config_weights("dimm", "ce-error", dimms.weight);
 
 	n = config_bool("socket", "socket-tracking-enabled");
 	if (n < 0) 
@@ -375,6 +897,26 @@ void memdb_config(void)
 
 	config_trigger("socket", "mem-ce-error", &sockets.ce_bucket_conf);
 	config_trigger("socket", "mem-uc-error", &sockets.uc_bucket_conf);
+	config_weights("socket", "mem-ce-error", sockets.weight);
+	trigger_template_init(&memdb_env);
+
+	n = config_bool("dimm", "dimm-idle-expiry");
+	if (n >= 0)
+		dimm_idle_expiry = n;
+	if (!memdb_enabled || !dimms.ce_bucket_conf.agetime)
+		dimm_idle_expiry = 0;
+	if (dimm_idle_expiry) {
+		dimm_wheel.check = memdimm_idle;
+		wheel_register(&dimm_wheel);
+	}
+
+	config_number("dimm", "device-share", "%u", &device_share);
+	config_number("dimm", "device-min-errors", "%u", &device_min_errors);
+	device_trigger = config_string("dimm", "device-trigger");
+	if (device_trigger && trigger_check(device_trigger) != 0) {
+		SYSERRprintf("Trigger `%s' not executable\n", device_trigger);
+		exit(1);
+	}
 }
 
 static int 
@@ -437,8 +979,8 @@ void prefill_memdb(int do_dmi)
 			continue;
 		}
 		md->memdev = d;
-		md->location = xstrdup(bl);
-		md->name = xstrdup(dmi_getstring(&d->header, d->device_locator));
+		md->location = xstrdup_tag(MEM_DIMM, bl);
+		md->name = xstrdup_tag(MEM_DIMM, dmi_getstring(&d->header, d->device_locator));
 	}
 	if (missed) { 
 		static int warned;
@@ -14,12 +14,32 @@ enum printflags {
 void prefill_memdb(int do_dmi);
 void memdb_config(void);
 void dump_memory_errors(FILE *f, enum printflags flags);
+int memdb_reset(int socketid, int channel, int dimm);
+void memdb_last_error(int *socketid, int *channel, int *dimm);
+void memdb_forget_error(void);
+int memdb_dimms_over(void);
+void memdb_use(enum acct_db db);
+int memdb_numdimms(enum acct_db db);
+void memdb_candidate_config(int limit);
+void dump_memory_errors_db(enum acct_db db, FILE *f, enum printflags flags);
+/* Socket ids of memory devices outside the CPU sockets, e.g. CXL memory expanders */
+#define MEMDEV_SOCKET_BASE 1000
 
-void memory_error(struct mce *m, int channel, int dimm, unsigned corr_err_cnt,
-			unsigned recordlen);
+void memdb_name(int socketid, int channel, int dimm, char *location);
+void memdb_device_error(struct mce *m, int channel, int dimm, int rank,
+			unsigned device);
+
+void memory_error(struct mce *m, int *channel, int *dimm, unsigned corr_err_cnt,
+			unsigned recordlen, enum mem_source src);
+
+extern const char *mem_source_name[MAX_MEM_SRC];
+void config_weights(const char *header, const char *base, unsigned *weight);
 
 struct memdimm;
 void memdb_trigger(char *msg, struct memdimm *md,  time_t t,
 		   struct err_type *et, struct bucket_conf *bc, char *argv[], bool sync,
            const char* reporter);
+void memdb_trigger_peer(char *msg, struct memdimm *md, struct memdimm *peer,
+		   char **extra, time_t t, struct err_type *et, struct bucket_conf *bc, char *argv[],
+		   bool sync, const char* reporter);
 struct memdimm *get_memdimm(int socketid, int channel, int dimm, int insert);
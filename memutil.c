@@ -21,6 +21,8 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <malloc.h>
+#include <unistd.h>
 #include "mcelog.h"
 #include "memutil.h"
 
@@ -62,6 +64,148 @@ char *xstrdup(char *str)
 	return str;
 }
 
+const char *mem_subsys_name[] = {
+	[MEM_OTHER] = "other",
+	[MEM_PAGE] = "page",
+	[MEM_DIMM] = "dimm",
+	[MEM_DMI] = "dmi",
+	[MEM_CACHE] = "cache",
+	[MEM_CLIENT] = "client",
+	[MEM_POLICY] = "policy",
+};
+
+struct mem_stats {
+	size_t live;
+	size_t peak;
+	size_t limit;		/* soft limit, 0 for none */
+	unsigned long allocs;
+	unsigned long over;	/* times the limit was exceeded */
+	unsigned long evictions;
+	void (*evict)(size_t excess);
+	int evicting;
+};
+
+static struct mem_stats mem_stats[MAX_MEM_SUBSYS];
+
+/*
+ * Account bytes to a subsystem. When it grows over its soft limit ask the
+ * subsystem to give memory back. The allocation itself never fails.
+ */
+void mem_account(enum mem_subsys s, long bytes)
+{
+	struct mem_stats *ms = &mem_stats[s];
+
+	if (bytes < 0 && (size_t)-bytes > ms->live)
+		bytes = -(long)ms->live;
+	ms->live += bytes;
+	if (bytes <= 0)
+		return;
+	ms->allocs++;
+	if (ms->live > ms->peak)
+		ms->peak = ms->live;
+	if (!ms->limit || ms->live <= ms->limit)
+		return;
+	ms->over++;
+	if (ms->evict && !ms->evicting) {
+		ms->evicting = 1;
+		ms->evict(ms->live - ms->limit);
+		ms->evicting = 0;
+		ms->evictions++;
+	}
+}
+
+/* Account a block that was allocated with malloc elsewhere */
+void mem_track(enum mem_subsys s, void *p)
+{
+	if (p)
+		mem_account(s, malloc_usable_size(p));
+}
+
+void mem_set_limit(enum mem_subsys s, size_t limit)
+{
+	mem_stats[s].limit = limit;
+}
+
+void mem_set_evict(enum mem_subsys s, void (*evict)(size_t excess))
+{
+	mem_stats[s].evict = evict;
+}
+
+size_t mem_usage(enum mem_subsys s)
+{
+	return mem_stats[s].live;
+}
+
+size_t mem_limit(enum mem_subsys s)
+{
+	return mem_stats[s].limit;
+}
+
+void *xalloc_tag(enum mem_subsys s, size_t size)
+{
+	void *m = xalloc(size);
+	mem_track(s, m);
+	return m;
+}
+
+void *xalloc_nonzero_tag(enum mem_subsys s, size_t size)
+{
+	void *m = xalloc_nonzero(size);
+	mem_track(s, m);
+	return m;
+}
+
+void *xrealloc_tag(enum mem_subsys s, void *old, size_t size)
+{
+	size_t oldsize = old ? malloc_usable_size(old) : 0;
+	void *m = xrealloc(old, size);
+	mem_account(s, (long)malloc_usable_size(m) - (long)oldsize);
+	return m;
+}
+
+char *xstrdup_tag(enum mem_subsys s, char *str)
+{
+	str = xstrdup(str);
+	mem_track(s, str);
+	return str;
+}
+
+void xfree_tag(enum mem_subsys s, void *p)
+{
+	if (!p)
+		return;
+	mem_account(s, -(long)malloc_usable_size(p));
+	free(p);
+}
+
+void dump_memstats(FILE *f)
+{
+	struct mem_stats *ms;
+	unsigned long size, rss;
+	size_t total = 0;
+	FILE *statm;
+	int i;
+
+	for (i = 0; i < MAX_MEM_SUBSYS; i++) {
+		ms = &mem_stats[i];
+		total += ms->live;
+		fprintf(f, "%s: live %zu peak %zu allocs %lu", mem_subsys_name[i],
+			ms->live, ms->peak, ms->allocs);
+		if (ms->limit)
+			fprintf(f, " limit %zu over %lu evictions %lu", ms->limit,
+				ms->over, ms->evictions);
+		fprintf(f, "\n");
+	}
+	fprintf(f, "total: live %zu\n", total);
+	statm = fopen("/proc/self/statm", "r");
+	if (statm) {
+		if (fscanf(statm, "%lu %lu", &size, &rss) == 2)
+			fprintf(f, "process: size %lu rss %lu\n",
+				size * getpagesize(), rss * getpagesize());
+		fclose(statm);
+	}
+}
+
 int xvasprintf(char **strp, const char *fmt, va_list ap)
 {
 	int n;
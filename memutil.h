@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdarg.h>
 
 int xasprintf(char **strp, const char *fmt, ...);
@@ -8,3 +9,30 @@ void *xalloc_nonzero(size_t size);
 void *xrealloc(void *old, size_t size);
 char *xstrdup(char *str);
 void Enomem(void);
+
+/* Daemon memory is accounted per subsystem. Keep in sync with mem_subsys_name. */
+enum mem_subsys {
+	MEM_OTHER,
+	MEM_PAGE,	/* page error database */
+	MEM_DIMM,	/* DIMM and socket error database */
+	MEM_DMI,	/* SMBIOS tables */
+	MEM_CACHE,	/* cache topology and cache error state */
+	MEM_CLIENT,	/* server client buffers */
+	MEM_POLICY,	/* candidate policy databases */
+	MAX_MEM_SUBSYS
+};
+
+extern const char *mem_subsys_name[];
+
+void *xalloc_tag(enum mem_subsys s, size_t size);
+void *xalloc_nonzero_tag(enum mem_subsys s, size_t size);
+void *xrealloc_tag(enum mem_subsys s, void *old, size_t size);
+char *xstrdup_tag(enum mem_subsys s, char *str);
+void xfree_tag(enum mem_subsys s, void *p);
+void mem_track(enum mem_subsys s, void *p);
+void mem_account(enum mem_subsys s, long bytes);
+void mem_set_limit(enum mem_subsys s, size_t limit);
+void mem_set_evict(enum mem_subsys s, void (*evict)(size_t excess));
+size_t mem_usage(enum mem_subsys s);
+size_t mem_limit(enum mem_subsys s);
+void dump_memstats(FILE *f);
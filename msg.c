@@ -156,6 +156,15 @@ void Gprintf(char *fmt, ...)
 	}
 }
 
+/* Redirect log output to f (NULL for stdout). Returns the previous stream. */
+FILE *redirect_log(FILE *f)
+{
+	FILE *old = output_fh;
+
+	output_fh = f;
+	return old;
+}
+
 void flushlog(void)
 {
 	FILE *f = output_fh ? output_fh : stdout;
@@ -1,4 +1,5 @@
 int need_stdout(void);
 void flushlog(void);
+FILE *redirect_log(FILE *f);
 void reopenlog(void);
 /* others are in mcelog.h */
@@ -22,6 +22,7 @@
 */
 #include <stdio.h>
 #include <stddef.h>
+#include <time.h>
 #include "mcelog.h"
 #include "p4.h"
 #include "core2.h"
@@ -43,6 +44,7 @@
 #include "i10nm.h"
 #include "sapphire.h"
 #include "granite.h"
+#include "health.h"
 
 /* decode mce for P4/Xeon and Core2 family */
 
@@ -125,9 +127,6 @@ static char* get_II_str(__u8 i)
 	return II[i];
 }
 
-static int decode_mca(u64 status, u64 misc, u64 track, int cpu, int *ismemerr, int socket,
-			u8 bank)
-{
 #define TLB_LL_MASK      0x3  /*bit 0, bit 1*/
 #define TLB_LL_SHIFT     0x0
 #define TLB_TT_MASK      0xc  /*bit 2, bit 3*/
@@ -137,6 +136,32 @@ static int decode_mca(u64 status, u64 misc, u64 track, int cpu, int *ismemerr, i
 #define CACHE_LL_SHIFT   0x0
 #define CACHE_TT_MASK    0xc  /*bit 2, bit 3*/
 #define CACHE_TT_SHIFT   0x2
+
+/* A cache or TLB error with the yellow threshold indication */
+static void cache_yellow(u32 mca, int cpu, int socket, time_t t)
+{
+	unsigned levelnum, typenum;
+
+	if ((mca >> 2) == 3) {
+		levelnum = mca & 3;
+		run_yellow_trigger(cpu, -1, levelnum, "unknown",
+				   get_LL_str(levelnum), socket, t);
+	} else if (test_prefix(4, mca)) {
+		typenum = (mca & TLB_TT_MASK) >> TLB_TT_SHIFT;
+		levelnum = (mca & TLB_LL_MASK) >> TLB_LL_SHIFT;
+		run_yellow_trigger(cpu, typenum, levelnum, get_TT_str(typenum),
+				   get_LL_str(levelnum), socket, t);
+	} else if (test_prefix(8, mca)) {
+		typenum = (mca & CACHE_TT_MASK) >> CACHE_TT_SHIFT;
+		levelnum = ((mca & CACHE_LL_MASK) >> CACHE_LL_SHIFT) + 1;
+		run_yellow_trigger(cpu, typenum, levelnum, get_TT_str(typenum),
+				   get_LL_str(levelnum), socket, t);
+	}
+}
+
+static int decode_mca(u64 status, u64 misc, u64 track, int cpu, int *ismemerr, int socket,
+			u8 bank, time_t t)
+{
 #define CACHE_RRRR_MASK  0xF0 /*bit 4, bit 5, bit 6, bit 7 */
 #define CACHE_RRRR_SHIFT 0x4
 
@@ -180,8 +205,6 @@ static int decode_mca(u64 status, u64 misc, u64 track, int cpu, int *ismemerr, i
 		levelnum = mca & 3;
 		level = get_LL_str(levelnum);
 		Wprintf("%s Generic cache hierarchy error\n", level);
-		if (track == 2)
-			run_yellow_trigger(cpu, -1, levelnum, "unknown", level, socket);
 	} else if (test_prefix(4, mca)) {
 		unsigned levelnum, typenum;
 		char *level, *type;
@@ -190,8 +213,6 @@ static int decode_mca(u64 status, u64 misc, u64 track, int cpu, int *ismemerr, i
 		levelnum = (mca & TLB_LL_MASK) >> TLB_LL_SHIFT;
 		level = get_LL_str(levelnum);
 		Wprintf("%s TLB %s Error\n", type, level);
-		if (track == 2)
-			run_yellow_trigger(cpu, typenum, levelnum, type, level, socket);
 	} else if (test_prefix(8, mca)) {
 		unsigned typenum = (mca & CACHE_TT_MASK) >> CACHE_TT_SHIFT;
 		unsigned levelnum = ((mca & CACHE_LL_MASK) >> CACHE_LL_SHIFT) + 1;
@@ -200,8 +221,6 @@ static int decode_mca(u64 status, u64 misc, u64 track, int cpu, int *ismemerr, i
 		Wprintf("%s CACHE %s %s Error\n", type, level,
 				get_RRRR_str((mca & CACHE_RRRR_MASK) >> 
 					      CACHE_RRRR_SHIFT));
-		if (track == 2)
-			run_yellow_trigger(cpu, typenum, levelnum, type, level,socket);
 	} else if (test_prefix(9, mca) && EXTRACT(mca, 7, 8) == 1) {
 		Wprintf("Memory as cache: ");
 		decode_memory_controller(mca, bank);
@@ -248,6 +267,8 @@ static int decode_mca(u64 status, u64 misc, u64 track, int cpu, int *ismemerr, i
 		Wprintf("Unknown Error %x\n", mca);
 		ret = 1;
 	}
+	if (track == 2)
+		cache_yellow(mca, cpu, socket, t);
 	return ret;
 }
 
@@ -319,7 +340,7 @@ static int check_for_mirror(__u8 bank, __u64  status, __u64 misc)
 }
 
 static int decode_mci(__u64 status, __u64 misc, int cpu, unsigned mcgcap, int *ismemerr,
-		       int socket, __u8 bank)
+		       int socket, __u8 bank, time_t t)
 {
 	u64 track = 0;
 	int i;
@@ -333,9 +354,11 @@ static int decode_mci(__u64 status, __u64 misc, int cpu, unsigned mcgcap, int *i
 	
 	if (status & MCI_STATUS_UC) 
 		Wprintf("Uncorrected error\n");
-	else if ((i = check_for_mirror(bank, status, misc)))
+	else if ((i = check_for_mirror(bank, status, misc))) {
 		Wprintf("Corrected error by %s\n", ce_types[i]);
-	else
+		if (i == 1)
+			health_failover();
+	} else
 		Wprintf("Corrected error\n");
 
 	if (status & MCI_STATUS_EN)
@@ -362,7 +385,7 @@ static int decode_mci(__u64 status, __u64 misc, int cpu, unsigned mcgcap, int *i
 		decode_tracking(track);
 	}
 	Wprintf("MCA: ");
-	return decode_mca(status, misc, track, cpu, ismemerr, socket, bank);
+	return decode_mca(status, misc, track, cpu, ismemerr, socket, bank, t);
 }
 
 static void decode_mcg(__u64 mcgstatus)
@@ -391,6 +414,23 @@ static void decode_thermal(struct mce *log, int cpu)
 	} 
 }
 
+/*
+ * The cache threshold indication of a record without decoding it, for
+ * the candidate policy.
+ */
+void intel_cache_threshold(struct mce *log, unsigned size)
+{
+	int socket = size > offsetof(struct mce, socketid) ? (int)log->socketid : -1;
+	int cpu = log->extcpu ? log->extcpu : log->cpu;
+	u64 status = log->status;
+
+	if (log->bank == MCE_THERMAL_BANK || (status & MCI_STATUS_UC) ||
+	    !(log->mcgcap == 0 || (log->mcgcap & MCG_TES_P)))
+		return;
+	if (((status >> 53) & 3) == 2)
+		cache_yellow(status & 0xefff, cpu, socket, log->time);
+}
+
 void decode_intel_mc(struct mce *log, int cputype, int *ismemerr, unsigned size)
 {
 	int socket = size > offsetof(struct mce, socketid) ? (int)log->socketid : -1;
@@ -404,7 +444,7 @@ void decode_intel_mc(struct mce *log, int cputype, int *ismemerr, unsigned size)
 
 	decode_mcg(log->mcgstatus);
 	if (decode_mci(log->status, log->misc, cpu, log->mcgcap, ismemerr,
-		socket, log->bank))
+		socket, log->bank, log->time))
 		run_unknown_trigger(socket, cpu, log);
 
 	if (test_prefix(11, (log->status & 0xffffL))) {
@@ -1,4 +1,5 @@
 char *intel_bank_name(int num);
 void decode_intel_mc(struct mce *log, int cpu, int *ismemerr, unsigned len);
+void intel_cache_threshold(struct mce *log, unsigned len);
 
 
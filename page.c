@@ -27,7 +27,9 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/mman.h>
-#include <assert.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include "memutil.h"
 #include "trigger.h"
 #include "mcelog.h"
@@ -38,6 +40,13 @@
 #include "config.h"
 #include "memdb.h"
 #include "sysfs.h"
+#include "memcg.h"
+#include "coldpage.h"
+#include "wheel.h"
+#include "eventloop.h"
+#include "trace.h"
+#include "health.h"
+#include "pressure.h"
 
 /* sets up 2^12 = 4k BYTE page size*/
 
@@ -46,7 +55,8 @@
 
 /* a page can either be online or offline*/
 
-enum { PAGE_ONLINE = 0, PAGE_OFFLINE = 1, PAGE_OFFLINE_FAILED = 2 };
+enum { PAGE_ONLINE = 0, PAGE_OFFLINE = 1, PAGE_OFFLINE_FAILED = 2, PAGE_FREE = 3,
+       PAGE_UNCORRECTED = 4 };
 
 /* represents a memory page, storing error-related information and its status online/offline*/
 struct mempage { 
@@ -54,8 +64,11 @@ struct mempage {
 	/* one char used by rb_node, node for integrating into red-black tree for efficent lookup */
 	char offlined; //status of the page
 	char triggered; //flag indicating if a trigger has been activated for this page
-	// 1(32bit)-5(64bit) bytes of padding to play with here
+	char queued; //on the idle expiry wheel
+	// 0(32bit)-4(64bit) bytes of padding to play with here
 	u64 addr;
+	/* idle expiry, or the free list after the page was reclaimed */
+	struct wheel_node wn;
 
 	/*err_type stores leaky bucket and count; each page has a leaky bucket*/
 	struct err_type ce;
@@ -76,57 +89,130 @@ struct mempage_replacement { //tracks page replacements when error thresholds ar
 	unsigned count;
 };
 
-enum {
-	MAX_ENV = 20,
+enum otype {  //different type of offlining strategies
+	OFFLINE_OFF,  
+	OFFLINE_ACCOUNT, 
+	OFFLINE_SOFT, 
+	OFFLINE_HARD,
+	OFFLINE_SOFT_THEN_HARD //attempt soft offlining first then hard offliing if soft fails
+};
+
+/* pages tracked by the shadow database for synthetic records */
+#define SHADOW_PAGES ((int)(4 * N))
+
+/*
+ * A page database with its threshold and action: the live one, the
+ * shadow for synthetic records or the one of the candidate policy.
+ */
+struct pagedb {
+	int corr_err_counters;
+	struct mempage_cluster *mp_cluster;
+	struct mempage_cluster *mp_victim;	/* cluster being recycled */
+	unsigned mp_victim_next;
+	struct wheel_node *mp_free;		/* reclaimed idle pages */
+	unsigned long mp_reclaimed;
+	struct mempage_replacement mp_repalcement;
+	struct rb_root mempage_root; //red-black tree structure used to store and lookup mempages efficciently based on page addresses
+	struct list_head mempage_cluster_lru_list;
+	unsigned long page_src[MAX_MEM_SRC];	/* corrected errors by source */
+	int limit;			/* pages, 0 for max_corr_err_counters */
+	enum mem_subsys mem;
+	struct bucket_conf *conf;
+	unsigned *weight;
+	enum otype *offline;
 };
 
-static int corr_err_counters;
-static struct mempage_cluster *mp_cluster;
-static struct mempage_replacement mp_repalcement;
-static struct rb_root mempage_root; //red-black tree structure used to store and lookup mempages efficciently based on page addresses
-static LIST_HEAD(mempage_cluster_lru_list);
 static struct bucket_conf page_trigger_conf;
+static unsigned page_weight[MAX_MEM_SRC] = { 1, 1, 1, 1 };
+static enum otype offline = OFFLINE_OFF;
+static struct bucket_conf candidate_conf;
+static unsigned candidate_weight[MAX_MEM_SRC];
+static enum otype candidate_offline;
+
+static struct pagedb live_pages = {
+	.mempage_cluster_lru_list = LIST_HEAD_INIT(live_pages.mempage_cluster_lru_list),
+	.mem = MEM_PAGE,
+	.conf = &page_trigger_conf, .weight = page_weight, .offline = &offline,
+};
+static struct pagedb shadow_pages = {
+	.mempage_cluster_lru_list = LIST_HEAD_INIT(shadow_pages.mempage_cluster_lru_list),
+	.limit = SHADOW_PAGES, .mem = MEM_PAGE,
+	.conf = &page_trigger_conf, .weight = page_weight, .offline = &offline,
+};
+static struct pagedb candidate_pages = {
+	.mempage_cluster_lru_list = LIST_HEAD_INIT(candidate_pages.mempage_cluster_lru_list),
+	.mem = MEM_POLICY,
+	.conf = &candidate_conf, .weight = candidate_weight, .offline = &candidate_offline,
+};
+static struct pagedb *pdb = &live_pages;
+static struct pagedb *dbs[] = {
+	[DB_LIVE] = &live_pages,
+	[DB_SHADOW] = &shadow_pages,
+	[DB_CANDIDATE] = &candidate_pages,
+};
+
+static unsigned long cold_pages;
+static int page_cap;		/* pages while over the memory limit, 0 for none */
+static unsigned long pages_offlined;	/* successfully, since start */
+static int page_idle_expiry = 1;
+static struct wheel page_wheel;
 static struct bucket_conf mp_replacement_trigger_conf;
+static struct trigger_template counter_env;
 static char *page_error_pre_soft_trigger, *page_error_post_soft_trigger;
 
 static const char *page_state[] = {
 	[PAGE_ONLINE] = "online",
 	[PAGE_OFFLINE] = "offline",
 	[PAGE_OFFLINE_FAILED] = "offline-failed",
+	[PAGE_FREE] = "free",
+	[PAGE_UNCORRECTED] = "uncorrected",
 };
 
 static struct mempage *mempage_alloc(void) //allocates new mempage from a cluster
 {
-	if (!mp_cluster || mp_cluster->mp_used == N) {
-		mp_cluster = mmap(0, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-		if (mp_cluster == MAP_FAILED)
+	struct mempage *mp;
+
+	/* reuse the slot of a page that expired idle first */
+	if (pdb->mp_free) {
+		mp = container_of(pdb->mp_free, struct mempage, wn);
+		pdb->mp_free = pdb->mp_free->next;
+		mp->offlined = PAGE_ONLINE;
+		mp->triggered = 0;
+		mp->ce.count = 0;
+		return mp;
+	}
+
+	if (!pdb->mp_cluster || pdb->mp_cluster->mp_used == N) {
+		pdb->mp_cluster = mmap(0, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pdb->mp_cluster == MAP_FAILED)
 			Enomem();
+		mem_account(pdb->mem, PAGE_SIZE);
+		list_add(&pdb->mp_cluster->lru, &pdb->mempage_cluster_lru_list);
 	}
 
-	return &mp_cluster->mp[mp_cluster->mp_used++];
+	return &pdb->mp_cluster->mp[pdb->mp_cluster->mp_used++];
 }
 
-static struct mempage *mempage_replace(void) //pages can be replaced if cluster is full
+/*
+ * Over the memory limit: stop growing the page database. Pages already
+ * tracked are kept, new ones reuse the least recently used clusters
+ * until the usage is below the limit again.
+ */
+static void page_evict(size_t excess)
 {
-	struct mempage *mp;
-
-	/* If no free mp_cluster, reuse the last mp_cluster of the LRU list  */
-	if (mp_cluster->mp_used == N) {
-		mp_cluster = list_last_entry(&mempage_cluster_lru_list, struct mempage_cluster, lru);
-		mp_cluster->mp_used = 0;
-	}
+	/* includes the cluster that is being filled */
+	int n = roundup(live_pages.corr_err_counters + 1, N);
 
-	mp = &mp_cluster->mp[mp_cluster->mp_used++];
-	mp->offlined = PAGE_ONLINE;
-	mp->triggered = 0;
-	mp->ce.count = 0;
-
-	return mp;
+	(void)excess;
+	if (n >= max_corr_err_counters || (page_cap && n >= page_cap))
+		return;
+	Lprintf("Page error database over memory limit, tracking at most %d pages\n", n);
+	page_cap = n;
 }
 
 static struct mempage *mempage_lookup(u64 addr) //searches for a page in red-black tree
 {
-	struct rb_node *n = mempage_root.rb_node;
+	struct rb_node *n = pdb->mempage_root.rb_node;
 
 	while (n) {
 		struct mempage *mp = rb_entry(n, struct mempage, nd);
@@ -147,7 +233,7 @@ static struct mempage *mempage_lookup(u64 addr) //searches for a page in red-bla
 static struct mempage *
 mempage_insert_lookup(u64 addr, struct rb_node * node) //finds the correct position in the tree and links the node
 {
-	struct rb_node **p = &mempage_root.rb_node;
+	struct rb_node **p = &pdb->mempage_root.rb_node;
 	struct rb_node *parent = NULL;
 	struct mempage *mp;
 
@@ -163,7 +249,7 @@ mempage_insert_lookup(u64 addr, struct rb_node * node) //finds the correct posit
 			return mp;
 	}
 	rb_link_node(node, parent, p);
-	rb_insert_color(node, &mempage_root);
+	rb_insert_color(node, &pdb->mempage_root);
 	return NULL;
 }
 
@@ -176,35 +262,47 @@ static struct mempage *mempage_insert(u64 addr, struct mempage *mp) //inserts ne
 	return mp;
 }
 
-static void mempage_rb_tree_update(u64 addr, struct mempage *mp) //updates red black tree when replacing a mem page
+static struct mempage *mempage_replace(u64 addr) //pages can be replaced if cluster is full
 {
-	rb_erase(&mp->nd, &mempage_root);
+	struct mempage *mp;
+
+	/*
+	 * All pages are in use, reuse the last mp_cluster of the LRU list.
+	 * This has its own cursor so that allocation of fresh pages
+	 * continues where it was after idle pages were reclaimed.
+	 */
+	if (!pdb->mp_victim || pdb->mp_victim_next == N) {
+		pdb->mp_victim = list_last_entry(&pdb->mempage_cluster_lru_list, struct mempage_cluster, lru);
+		pdb->mp_victim_next = 0;
+	}
+
+	mp = &pdb->mp_victim->mp[pdb->mp_victim_next++];
+	/* keep the error count of the evicted page in the cold tier */
+	if (mp->offlined == PAGE_ONLINE && !mp->triggered && pdb == &live_pages)
+		cold_put(mp->addr >> PAGE_SHIFT, mp->ce.bucket.count,
+			 mp->ce.count, mp->ce.bucket.tstamp);
+	/* a forgotten page waiting for the wheel is not in the tree anymore */
+	if (mp->offlined != PAGE_FREE)
+		rb_erase(&mp->nd, &pdb->mempage_root);
+	mp->offlined = PAGE_ONLINE;
+	mp->triggered = 0;
+	mp->ce.count = 0;
 	mempage_insert(addr, mp);
-}
-//LRU list management; manages LRU list by adding or moving mempage_cluster entries to maintain usage order
-static void mempage_cluster_lru_list_insert(struct mempage_cluster *mp_cluster)
-{
-	list_add(&mp_cluster->lru, &mempage_cluster_lru_list);
+
+	return mp;
 }
 
+//LRU list management; moves mempage_cluster entries to maintain usage order
 static void mempage_cluster_lru_list_update(struct mempage_cluster *mp_cluster)
 {
-	if (list_is_first(&mp_cluster->lru, &mempage_cluster_lru_list))
+	if (list_is_first(&mp_cluster->lru, &pdb->mempage_cluster_lru_list))
 		return;
 
 	list_del(&mp_cluster->lru);
-	list_add(&mp_cluster->lru, &mempage_cluster_lru_list);
+	list_add(&mp_cluster->lru, &pdb->mempage_cluster_lru_list);
 }
 
-/* Following arrays need to be all kept in sync with the enum */
-
-enum otype {  //different type of offlining strategies
-	OFFLINE_OFF,  
-	OFFLINE_ACCOUNT, 
-	OFFLINE_SOFT, 
-	OFFLINE_HARD,
-	OFFLINE_SOFT_THEN_HARD //attempt soft offlining first then hard offliing if soft fails
-};
+/* Following arrays need to be all kept in sync with enum otype */
 
 static const char *kernel_offline[] = { 
 	[OFFLINE_SOFT] = "/sys/devices/system/memory/soft_offline_page",
@@ -221,11 +319,85 @@ static struct config_choice offline_choice[] = {
 	{}
 };
 
-static enum otype offline = OFFLINE_OFF;
+/* Action for uncorrected errors found by the patrol scrubber */
+static struct config_choice uc_offline_choice[] = {
+	{ "off", OFFLINE_OFF },
+	{ "account", OFFLINE_ACCOUNT },
+	{ "hard", OFFLINE_HARD },
+	{}
+};
+
+static enum otype uc_offline = OFFLINE_OFF;
+
+/* Poisoned pages waiting to be offlined, processed before anything else */
+struct offline_req {
+	struct list_head list;
+	struct rb_node nd;	/* in admin_pending, by address */
+	u64 addr;
+	time_t t;		/* time the machine check was logged */
+	struct timespec seen;	/* time mcelog read the record */
+	enum otype type;
+	unsigned npages;	/* consecutive pages from addr */
+	unsigned done;
+};
+
+static LIST_HEAD(offline_queue);
+
+/*
+ * Soft offlines of corrected error pages deferred while the system is
+ * under memory pressure. They are done once the pressure is gone, or
+ * paced once they waited max_defer seconds.
+ */
+static LIST_HEAD(soft_queue);
+static int soft_timer_fd = -1;
+static unsigned max_defer = 600;
+static unsigned soft_pace = 1;		/* pages per second under pressure */
+static unsigned soft_tokens;		/* pages that may be offlined now */
+static time_t soft_refilled;
+
+static struct {
+	unsigned long deferred;
+	unsigned long offlined;
+	unsigned long failed;
+	unsigned long overdue;
+	time_t max_delay;
+} soft_stats;
+
+/* Pages the administrator asked to offline, done a batch at a time */
+enum { ADMIN_BATCH = 64 };
+
+static LIST_HEAD(admin_queue);
+static struct rb_root admin_pending;	/* the same requests, to find them */
+static int admin_kick_fd = -1;
+
+static struct {
+	unsigned long queued;
+	unsigned long offlined;
+	unsigned long failed;
+} admin_stats;
+
+static struct {
+	unsigned long count;
+	unsigned long failed;
+	unsigned long long total_us;
+	unsigned long long max_us;
+	unsigned long long total_lag;
+	time_t max_lag;
+} uc_stats;
 
 static int do_memory_offline(u64 addr, enum otype type) //writes the memory page address to the appropriate sysfs entry to offline the page
 {
-	return sysfs_write(kernel_offline[type], "%#llx", addr);
+	unsigned long long start;
+	int ret;
+
+	if (dry_run) {
+		dry_run("offline page %llx", addr);
+		return 0;
+	}
+	start = trace_begin();
+	ret = sysfs_write(kernel_offline[type], "%#llx", addr);
+	trace_end("offline write", start, addr);
+	return ret;
 }
 
 // ----------------------------------------
@@ -254,7 +426,7 @@ static int memory_offline(u64 addr) /*determines offlining strategy based on off
 
 	const int num_consecutive_pages = 5;  //MODIFICATION - Number of consecutive pages to offline
 
-	if (offline == OFFLINE_SOFT_THEN_HARD) {
+	if (*pdb->offline == OFFLINE_SOFT_THEN_HARD) {
 		if (do_memory_offline(addr, OFFLINE_SOFT) < 0)  { 
 			Lprintf("Soft offlining of page %llx failed, trying hard offlining\n",
 				addr);
@@ -264,20 +436,137 @@ static int memory_offline(u64 addr) /*determines offlining strategy based on off
 	}
 	//return do_memory_offline(addr, offline); MODIFICATION - LINE HAS BEEN COMMENTED OUT
 
-	return do_consecutive_memory_offline(addr, num_consecutive_pages, offline);
+	return do_consecutive_memory_offline(addr, num_consecutive_pages, *pdb->offline);
 
 }
 
+/* Offline one page with a single offline type */
+static int offline_page(u64 addr, enum otype type)
+{
+	int ret;
+
+	if (type != OFFLINE_SOFT_THEN_HARD)
+		return do_memory_offline(addr, type);
+	ret = do_memory_offline(addr, OFFLINE_SOFT);
+	if (ret < 0)
+		ret = do_memory_offline(addr, OFFLINE_HARD);
+	return ret;
+}
+
+static void soft_timer(struct pollfd *pfd, void *data)
+{
+	uint64_t expirations;
+
+	(void)data;
+	if (read(pfd->fd, &expirations, sizeof(expirations)) < 0)
+		return;
+	page_offline_run();
+}
+
+/* Look at the deferred soft offlines again in a second */
+static int soft_arm(void)
+{
+	struct itimerspec its = { .it_value = { .tv_sec = 1 } };
+
+	if (soft_timer_fd < 0) {
+		soft_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+		if (soft_timer_fd < 0) {
+			SYSERRprintf("Cannot set up offline pacing timer");
+			return -1;
+		}
+		if (register_pollcb(soft_timer_fd, POLLIN, soft_timer, NULL) < 0) {
+			close(soft_timer_fd);
+			soft_timer_fd = -1;
+			return -1;
+		}
+	}
+	if (timerfd_settime(soft_timer_fd, 0, &its, NULL) < 0) {
+		SYSERRprintf("Cannot arm offline pacing timer");
+		return -1;
+	}
+	return 0;
+}
+
+/* Refill the pacing budget: soft_pace pages a second, saved up for one second */
+static void soft_refill(time_t now)
+{
+	unsigned long long tokens;
+
+	if (now <= soft_refilled)
+		return;
+	tokens = soft_tokens + (unsigned long long)(now - soft_refilled) * soft_pace;
+	soft_tokens = tokens > soft_pace ? soft_pace : tokens;
+	soft_refilled = now;
+}
+
+/*
+ * Defer the soft offline of a page of the live database while the
+ * system is under memory pressure. The offline worker runs the pre and
+ * post soft triggers around the offline later. Returns 1 when the page
+ * was queued.
+ */
+static int soft_defer(u64 addr)
+{
+	struct offline_req *req;
+	enum otype type = *pdb->offline;
+	enum pressure p;
+
+	if (pdb != &live_pages || dry_run ||
+	    (type != OFFLINE_SOFT && type != OFFLINE_SOFT_THEN_HARD))
+		return 0;
+	p = pressure_state();
+	if (p == PRESSURE_NORMAL)
+		return 0;
+	list_for_each_entry (req, &soft_queue, list)
+		if (req->addr == addr)
+			return 1;
+	/* nothing would come back for it */
+	if (soft_arm() < 0)
+		return 0;
+
+	req = xalloc_tag(MEM_PAGE, sizeof(struct offline_req));
+	req->addr = addr;
+	req->t = time(NULL);
+	clock_gettime(CLOCK_MONOTONIC, &req->seen);
+	req->type = type;
+	/* the same pages memory_offline would offline */
+	req->npages = type == OFFLINE_SOFT_THEN_HARD ? 1 : 5;
+	list_add_tail(&req->list, &soft_queue);
+	soft_stats.deferred++;
+	Lprintf("Offlining page %llx deferred, memory pressure is %s\n", addr,
+		p == PRESSURE_HIGH ? "high" : "being measured");
+	return 1;
+}
+
+/* Record the result of offlining a page */
+static void page_offlined(struct mempage *mp, int ret)
+{
+	if (ret < 0) {
+		mp->offlined = PAGE_OFFLINE_FAILED;
+		return;
+	}
+	if (mp->offlined != PAGE_OFFLINE && pdb == &live_pages)
+		pages_offlined++;
+	mp->offlined = PAGE_OFFLINE;
+	health_changed();
+}
+
+unsigned long page_offlined_count(void)
+{
+	return pages_offlined;
+}
+
 static void offline_action(struct mempage *mp, u64 addr)
 {
-	if (offline <= OFFLINE_ACCOUNT)
+	if (*pdb->offline <= OFFLINE_ACCOUNT)
 		return;
-	Lprintf("Offlining page %llx\n", addr);
+	if (!dry_run)
+		Lprintf("Offlining page %llx\n", addr);
 	if (memory_offline(addr) < 0) {
 		Lprintf("Offlining page %llx failed: %s\n", addr, strerror(errno));
-		mp->offlined = PAGE_OFFLINE_FAILED;
+		page_offlined(mp, -1);
 	} else
-		mp->offlined = PAGE_OFFLINE;
+		page_offlined(mp, 0);
 }
 
 /* Run a user defined trigger when the replacement threshold of page error counter crossed. */
@@ -285,34 +574,31 @@ static void counter_trigger(char *msg, time_t t, struct mempage_replacement *mr,
 			    struct bucket_conf *bc, bool sync)
 {
 	struct leaky_bucket *bk = &mr->bucket;
-	char *env[MAX_ENV], *out, *thresh;
-	int i, ei = 0;
+	struct trigger_env env;
+	char *out, *thresh;
 
 	thresh = bucket_output(bc, bk);
 	xasprintf(&out, "%s: %s", msg, thresh);
 
-	if (bc->log)
+	if (dry_run)
+		dry_run("report %s", out);
+	else if (bc->log)
 		Gprintf("%s\n", out);
 
 	if (!bc->trigger)
 		goto out;
 
-	xasprintf(&env[ei++], "THRESHOLD=%s", thresh);
-	xasprintf(&env[ei++], "TOTALCOUNT=%lu", mr->count);
+	trigger_env_init(&env, &counter_env);
+	trigger_env_add(&env, "THRESHOLD=%s", thresh);
+	trigger_env_add(&env, "TOTALCOUNT=%u", mr->count);
 	if (t)
-		xasprintf(&env[ei++], "LASTEVENT=%lu", t);
-	xasprintf(&env[ei++], "AGETIME=%u", bc->agetime);
-	xasprintf(&env[ei++], "MESSAGE=%s", out);
-	xasprintf(&env[ei++], "THRESHOLD_COUNT=%d", bk->count);
-	env[ei] = NULL;
-	assert(ei < MAX_ENV);
+		trigger_env_add(&env, "LASTEVENT=%lu", t);
+	trigger_env_add(&env, "AGETIME=%u", bc->agetime);
+	trigger_env_add(&env, "MESSAGE=%s", out);
+	trigger_env_add(&env, "THRESHOLD_COUNT=%d", bk->count);
 
-	run_trigger(bc->trigger, NULL, env, sync, "page-error-counter");
-
-	for (i = 0; i < ei; i++) {
-		free(env[i]);
-		env[i] = NULL;
-	}
+	run_trigger(bc->trigger, NULL, trigger_env(&env), sync,
+		    "page-error-counter");
 out:
 	free(out);
 	out = NULL;
@@ -320,15 +606,159 @@ out:
 	thresh = NULL;
 }
 
-void account_page_error(struct mce *m, int channel, int dimm) //core function that handles each memory error reported by system
+/* Pages the database may track, lifting the memory cap when there is room */
+static int page_limit(void)
+{
+	int limit = pdb->limit ? pdb->limit : max_corr_err_counters;
+	size_t mem_max;
+
+	if (pdb != &live_pages || !page_cap)
+		return limit;
+	mem_max = mem_limit(MEM_PAGE);
+	if (mem_max && mem_usage(MEM_PAGE) + PAGE_SIZE > mem_max)
+		return page_cap < limit ? page_cap : limit;
+	Lprintf("Page error database under memory limit again, tracking up to %d pages\n",
+		limit);
+	page_cap = 0;
+	return limit;
+}
+
+/* Find the counter for a page, allocating or recycling one if needed */
+static struct mempage *mempage_get(u64 addr, time_t t)
+{
+	struct mempage *mp;
+	char *msg, *thresh;
+	unsigned cold_count, cold_total;
+	time_t cold_t;
+	int cold;
+
+	mp = mempage_lookup(addr); //attempt to find an existing mempage for the address
+	cold = !mp && pdb == &live_pages &&
+		cold_take(addr >> PAGE_SHIFT, &cold_count, &cold_total, &cold_t);
+	if (!mp && (pdb->mp_free || pdb->corr_err_counters < page_limit())) { //if not found, allocate a new mempage, initialize its bucket, insert into red-black tree and LRU list increment error counter
+		//max_corr_err_counters is the max number of correctable error pages that can be tracked. The variable corr_err_counters keeps track of the current number of correctable error pages
+
+		mp = mempage_alloc();
+		bucket_init(&mp->ce.bucket);
+	        mempage_insert(addr, mp);
+		mempage_cluster_lru_list_update(to_cluster(mp));
+		pdb->corr_err_counters++;
+	} else if (!mp) { //if not found and maximum counters reached, replace an existing mempage, initialize its bucket...etc.
+		mp = mempage_replace(addr);
+		bucket_init(&mp->ce.bucket);
+		mempage_cluster_lru_list_update(to_cluster(mp));
+
+		/* Report how often the replacement of counter 'mp' happened */
+		++pdb->mp_repalcement.count; //tracks how often old error pages have been replaced by new ones
+		if (__bucket_account(&mp_replacement_trigger_conf, &pdb->mp_repalcement.bucket, 1, t)) {
+			thresh = bucket_output(&mp_replacement_trigger_conf, &pdb->mp_repalcement.bucket);
+			xasprintf(&msg, "Replacements of page correctable error counter exceed threshold %s", thresh);
+			free(thresh);
+			thresh = NULL;
+
+			counter_trigger(msg, t, &pdb->mp_repalcement, &mp_replacement_trigger_conf, false);
+			free(msg);
+			msg = NULL;
+		}
+	} else {
+		mempage_cluster_lru_list_update(to_cluster(mp));
+	}
+	if (cold) {
+		mp->ce.count = cold_total;
+		mp->ce.bucket.count = cold_count;
+		mp->ce.bucket.tstamp = cold_t;
+	}
+	if (page_idle_expiry && !mp->queued && pdb == &live_pages) {
+		mp->queued = 1;
+		wheel_add(&page_wheel, &mp->wn, t + page_trigger_conf.agetime);
+	}
+	return mp;
+}
+
+/*
+ * Reclaim a page whose error bucket drained completely. Offlined pages
+ * are kept, so that they are not offlined again.
+ */
+/* Put a page that was taken out of the tree on the free list */
+static void mempage_free(struct mempage *mp)
+{
+	mp->offlined = PAGE_FREE;
+	mp->wn.next = pdb->mp_free;
+	pdb->mp_free = &mp->wn;
+	pdb->corr_err_counters--;
+}
+
+static time_t mempage_idle(struct wheel_node *n, time_t now)
+{
+	struct mempage *mp = container_of(n, struct mempage, wn);
+	time_t expires;
+
+	if (mp->offlined == PAGE_FREE) {
+		/* forgotten while on the wheel */
+		mp->queued = 0;
+		mempage_free(mp);
+		return 0;
+	}
+	if (mp->offlined != PAGE_ONLINE) {
+		mp->queued = 0;
+		return 0;
+	}
+	expires = mp->ce.bucket.tstamp + page_trigger_conf.agetime;
+	if (expires > now)
+		return expires;
+	rb_erase(&mp->nd, &pdb->mempage_root);
+	mp->queued = 0;
+	mempage_free(mp);
+	pdb->mp_reclaimed++;
+	return 0;
+}
+
+/*
+ * Drop the counters of all pages in [start, end], e.g. after a DIMM was
+ * replaced. Returns the number of pages forgotten.
+ */
+unsigned long page_forget(u64 start, u64 end)
+{
+	struct rb_node *r = pdb->mempage_root.rb_node, *first = NULL, *next;
+	struct mempage *mp;
+	unsigned long n = 0;
+
+	while (r) {
+		mp = rb_entry(r, struct mempage, nd);
+		if (mp->addr >= start) {
+			first = r;
+			r = r->rb_left;
+		} else
+			r = r->rb_right;
+	}
+	for (r = first; r; r = next) {
+		mp = rb_entry(r, struct mempage, nd);
+		if (mp->addr > end)
+			break;
+		next = rb_next(r);
+		rb_erase(r, &pdb->mempage_root);
+		n++;
+		/* a queued page is freed when its slot on the wheel comes up */
+		if (mp->queued)
+			mp->offlined = PAGE_FREE;
+		else
+			mempage_free(mp);
+	}
+	return n + cold_forget(start >> PAGE_SHIFT, end >> PAGE_SHIFT);
+}
+
+void account_page_error(struct mce *m, int *channel, int *dimm,
+			enum mem_source src) //core function that handles each memory error reported by system
 {
 	u64 addr = m->addr;
 	struct mempage *mp;
 	char *msg, *thresh;
+	const char *owner;
 	time_t t;
+	int crossed;
 	unsigned cpu = m->extcpu ? m->extcpu : m->cpu;
 
-	if (offline == OFFLINE_OFF)
+	if (*pdb->offline == OFFLINE_OFF)
 		return; //exit if offlining disabled
 	if (!(m->status & MCI_STATUS_ADDRV)  || (m->status & MCI_STATUS_UC)) //check if error has valid address
 		return;
@@ -353,58 +783,46 @@ void account_page_error(struct mce *m, int channel, int dimm) //core function th
 	t = m->time;
 	//rounds down to nearest page size boundary
 	addr &= ~((u64)PAGE_SIZE - 1);
-	mp = mempage_lookup(addr); //attempt to find an existing mempage for the address
-	if (!mp && corr_err_counters < max_corr_err_counters) { //if not found, allocate a new mempage, initialize its bucket, insert into red-black tree and LRU list increment error counter
-		//max_corr_err_counters is the max number of correctable error pages that can be tracked. The variable corr_err_counters keeps track of the current number of correctable error pages
-
-		mp = mempage_alloc();
-		bucket_init(&mp->ce.bucket);
-	        mempage_insert(addr, mp);
-		mempage_cluster_lru_list_insert(to_cluster(mp));
-		corr_err_counters++;
-	} else if (!mp) { //if not found and maximum counters reached, replace an existing mempage, initialize its bucket...etc.
-		mp = mempage_replace();
-		bucket_init(&mp->ce.bucket);
-		mempage_rb_tree_update(addr, mp);
-		mempage_cluster_lru_list_update(to_cluster(mp));
-
-		/* Report how often the replacement of counter 'mp' happened */
-		++mp_repalcement.count; //tracks how often old error pages have been replaced by new ones
-		if (__bucket_account(&mp_replacement_trigger_conf, &mp_repalcement.bucket, 1, t)) {
-			thresh = bucket_output(&mp_replacement_trigger_conf, &mp_repalcement.bucket);
-			xasprintf(&msg, "Replacements of page correctable error counter exceed threshold %s", thresh);
-			free(thresh);
-			thresh = NULL;
-
-			counter_trigger(msg, t, &mp_repalcement, &mp_replacement_trigger_conf, false);
-			free(msg);
-			msg = NULL;
-		}
-	} else {
-		mempage_cluster_lru_list_update(to_cluster(mp));
-	}
+	mp = mempage_get(addr, t);
 	//increment error count for page -> adding to its bucket
 	++mp->ce.count;
+	pdb->page_src[src]++;
 	//checks if number of errors on page exceeds threshold using __bucket_account function..(page_trigger_conf kinda important for defining threshold?)
-	if (__bucket_account(&page_trigger_conf, &mp->ce.bucket, 1, t)) { 
-		struct memdimm *md;
+	/* scrub errors in idle memory can be weighted lower than demand reads */
+	crossed = __bucket_account(pdb->conf, &mp->ce.bucket,
+				   pdb->weight[src], t);
+	if (crossed)
+		trace_mark("page bucket overflow", addr);
+	/* the workload owning the page, so that it can be migrated */
+	owner = dry_run ? NULL :
+		memcg_error(addr, t, crossed && mp->offlined == PAGE_ONLINE);
+	if (crossed) { 
+		struct memdimm *md, *peer = NULL;
+		char *extra[] = { NULL, NULL };
 		//if page has already been offlined, skip rest of code
 		if (mp->offlined != PAGE_ONLINE)
 			return;
 		/* Only do triggers and messages for online pages. 
 		This generates a message that includes the number of errors and the time window during which they occurred.*/
-		thresh = bucket_output(&page_trigger_conf, &mp->ce.bucket);
-		md = get_memdimm(m->socketid, channel, dimm, 1);
-		xasprintf(&msg, "Corrected memory errors on page %llx exceed threshold %s",
-			addr, thresh);
+		thresh = bucket_output(pdb->conf, &mp->ce.bucket);
+		md = get_memdimm(m->socketid, channel[0], dimm[0], 1);
+		/* a page on a mirrored or lockstep pair is counted once, for both DIMMs */
+		if (channel[1] != -1)
+			peer = get_memdimm(m->socketid, channel[1], dimm[1], 1);
+		xasprintf(&msg, "Corrected memory errors on page %llx exceed threshold %s%s%s",
+			addr, thresh, owner ? " in memory cgroup " : "", owner ?: "");
+		if (owner)
+			xasprintf(&extra[0], "MEMCG=%s", owner);
 		free(thresh);
 		thresh = NULL;
-		memdb_trigger(msg, md, t, &mp->ce, &page_trigger_conf, NULL, false, "page");
+		memdb_trigger_peer(msg, md, peer, extra, t, &mp->ce, pdb->conf, NULL, false, "page");
 		free(msg);
 		msg = NULL;
 		mp->triggered = 1; // marks that the page has triggered this threshold-based error handling
 
-		if (offline == OFFLINE_SOFT || offline == OFFLINE_SOFT_THEN_HARD) {
+		if (soft_defer(addr)) {
+			/* the offline worker runs the soft triggers */
+		} else if (*pdb->offline == OFFLINE_SOFT || *pdb->offline == OFFLINE_SOFT_THEN_HARD) {
 			struct bucket_conf page_soft_trigger_conf;
 			char *argv[] = {
 				NULL,
@@ -416,45 +834,327 @@ void account_page_error(struct mce *m, int channel, int dimm) //core function th
 			asprintf(&args, "%lld", addr);
 			argv[0]=args;
 
-			memcpy(&page_soft_trigger_conf, &page_trigger_conf, sizeof(struct bucket_conf));
+			memcpy(&page_soft_trigger_conf, pdb->conf, sizeof(struct bucket_conf));
 			page_soft_trigger_conf.trigger = page_error_pre_soft_trigger;
 			argv[0]=page_error_pre_soft_trigger;
 			argv[1]=args;
 			asprintf(&msg, "pre soft trigger run for page %lld", addr);
-			memdb_trigger(msg, md, t, &mp->ce, &page_soft_trigger_conf, argv, true, "page_pre_soft");
+			memdb_trigger_peer(msg, md, peer, extra, t, &mp->ce, &page_soft_trigger_conf, argv, true, "page_pre_soft");
 			free(msg);
 			msg = NULL;
 
 			offline_action(mp, addr);
 
-			memcpy(&page_soft_trigger_conf, &page_trigger_conf, sizeof(struct bucket_conf));
+			memcpy(&page_soft_trigger_conf, pdb->conf, sizeof(struct bucket_conf));
 			page_soft_trigger_conf.trigger = page_error_post_soft_trigger;
 			argv[0]=page_error_post_soft_trigger;
 			argv[1]=args;
 			asprintf(&msg, "post soft trigger run for page %lld", addr);
-			memdb_trigger(msg, md, t, &mp->ce, &page_soft_trigger_conf, argv, true, "page_post_soft");
+			memdb_trigger_peer(msg, md, peer, extra, t, &mp->ce, &page_soft_trigger_conf, argv, true, "page_post_soft");
 			free(msg);
 			msg = NULL;
 			free(args);
 			args = NULL;
 		} else
 			offline_action(mp, addr);
+		free(extra[0]);
+		extra[0] = NULL;
 	}
 }
 
-void dump_page_errors(FILE *f) //outputs current state of memory page errors to a file
+/*
+ * Queue the page of an uncorrected error found by the patrol scrubber
+ * for offlining. Nothing consumed the data yet, so removing the page
+ * now avoids a later SRAR kill of whoever touches it first.
+ */
+void page_offline_uc(struct mce *m, struct timespec *seen)
+{
+	u64 addr = m->addr & ~((u64)PAGE_SIZE - 1);
+	struct offline_req *req;
+	struct mempage *mp;
+
+	if (uc_offline == OFFLINE_OFF)
+		return;
+	if (dry_run) {
+		if (uc_offline == OFFLINE_HARD)
+			dry_run("offline page %llx", addr);
+		return;
+	}
+	mp = mempage_lookup(addr);
+	if (mp && mp->offlined == PAGE_OFFLINE)
+		return;
+	list_for_each_entry (req, &offline_queue, list)
+		if (req->addr == addr)
+			return;
+
+	req = xalloc_tag(MEM_PAGE, sizeof(struct offline_req));
+	req->addr = addr;
+	req->t = m->time;
+	req->seen = *seen;
+	req->type = uc_offline;
+	list_add_tail(&req->list, &offline_queue);
+}
+
+/* Offline a batch of requested pages, the rest runs from the event loop */
+static void admin_offline_run(void)
+{
+	struct offline_req *req, *tmp;
+	struct mempage *mp;
+	int n = 0, ret;
+
+	list_for_each_entry_safe (req, tmp, &admin_queue, list) {
+		if (n++ == ADMIN_BATCH) {
+			if (eventfd_write(admin_kick_fd, 1) < 0)
+				SYSERRprintf("Cannot wake up offline worker");
+			break;
+		}
+		list_del(&req->list);
+		rb_erase(&req->nd, &admin_pending);
+		Lprintf("Offlining page %llx on request\n", req->addr);
+		ret = offline_page(req->addr, req->type);
+		if (ret < 0) {
+			Lprintf("Offlining page %llx failed: %s\n", req->addr,
+				strerror(errno));
+			admin_stats.failed++;
+		} else
+			admin_stats.offlined++;
+		/* keep the page database in sync */
+		mp = mempage_get(req->addr, req->t);
+		page_offlined(mp, ret);
+		xfree_tag(MEM_PAGE, req);
+	}
+}
+
+/* The pre or post soft trigger of a deferred offline */
+static void soft_trigger(char *trigger, struct offline_req *req, const char *when,
+			 const char *reporter)
+{
+	struct trigger_env env;
+	char *argv[] = { trigger, NULL, NULL };
+	char *args;
+
+	if (!trigger)
+		return;
+	xasprintf(&args, "%lld", req->addr);
+	argv[1] = args;
+	trigger_env_init(&env, &counter_env);
+	trigger_env_add(&env, "MESSAGE=%s soft trigger run for page %lld", when, req->addr);
+	trigger_env_add(&env, "LASTEVENT=%lu", req->t);
+	run_trigger(trigger, argv, trigger_env(&env), true, reporter);
+	free(args);
+}
+
+/*
+ * Do the deferred soft offlines when the memory pressure is gone. Under
+ * pressure only the ones that waited max_defer seconds are done, at most
+ * soft_pace pages each second.
+ */
+static void soft_offline_run(void)
+{
+	struct offline_req *req, *tmp;
+	struct mempage *mp;
+	struct timespec now;
+	time_t delay;
+	int high, ret;
+
+	if (list_empty(&soft_queue))
+		return;
+	high = pressure_state() != PRESSURE_NORMAL;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	soft_refill(now.tv_sec);
+	list_for_each_entry_safe (req, tmp, &soft_queue, list) {
+		delay = now.tv_sec - req->seen.tv_sec;
+		/* oldest first: the rest waited less */
+		if (high && delay < (time_t)max_defer)
+			break;
+		if (high && req->done == 0 && !soft_tokens)
+			break;
+		if (high && req->done == 0)
+			soft_stats.overdue++;
+		if (req->done == 0)
+			soft_trigger(page_error_pre_soft_trigger, req, "pre", "page_pre_soft");
+		ret = 0;
+		while (req->done < req->npages && (!high || soft_tokens)) {
+			u64 addr = req->addr + req->done * PAGE_SIZE;
+
+			Lprintf("Offlining page %llx after %lus\n", addr, (unsigned long)delay);
+			ret = offline_page(addr, req->type);
+			if (ret < 0) {
+				Lprintf("Offlining page %llx failed: %s\n", addr,
+					strerror(errno));
+				break;
+			}
+			req->done++;
+			if (high)
+				soft_tokens--;
+		}
+		if (ret == 0 && req->done < req->npages)
+			break;
+		list_del(&req->list);
+		if (ret < 0)
+			soft_stats.failed++;
+		else
+			soft_stats.offlined++;
+		if (delay > soft_stats.max_delay)
+			soft_stats.max_delay = delay;
+		mp = mempage_get(req->addr, req->t);
+		page_offlined(mp, ret);
+		soft_trigger(page_error_post_soft_trigger, req, "post", "page_post_soft");
+		xfree_tag(MEM_PAGE, req);
+	}
+	if (!list_empty(&soft_queue))
+		soft_arm();
+}
+
+void page_offline_run(void)
+{
+	struct offline_req *req, *tmp;
+	struct mempage *mp;
+	struct timespec now;
+	unsigned long long us;
+	time_t lag;
+	int ret = 0;
+
+	list_for_each_entry_safe (req, tmp, &offline_queue, list) {
+		list_del(&req->list);
+		if (uc_offline == OFFLINE_HARD) {
+			Lprintf("Offlining page %llx with uncorrected patrol scrub error\n",
+				req->addr);
+			ret = do_memory_offline(req->addr, OFFLINE_HARD);
+			if (ret < 0)
+				Lprintf("Offlining page %llx failed: %s\n", req->addr,
+					strerror(errno));
+		} else
+			Lprintf("Uncorrected patrol scrub error on page %llx\n",
+				req->addr);
+
+		mp = mempage_get(req->addr, req->t);
+		if (uc_offline == OFFLINE_HARD)
+			page_offlined(mp, ret);
+		else if (mp->offlined == PAGE_ONLINE)
+			mp->offlined = PAGE_UNCORRECTED;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		us = (now.tv_sec - req->seen.tv_sec) * 1000000ULL +
+			(now.tv_nsec - req->seen.tv_nsec) / 1000;
+		uc_stats.count++;
+		if (ret < 0)
+			uc_stats.failed++;
+		uc_stats.total_us += us;
+		if (us > uc_stats.max_us)
+			uc_stats.max_us = us;
+		lag = time(NULL) - req->t;
+		if (lag < 0)
+			lag = 0;
+		uc_stats.total_lag += lag;
+		if (lag > uc_stats.max_lag)
+			uc_stats.max_lag = lag;
+		xfree_tag(MEM_PAGE, req);
+	}
+
+	soft_offline_run();
+	admin_offline_run();
+}
+
+static void admin_kick(struct pollfd *pfd, void *data)
+{
+	eventfd_t v;
+
+	(void)data;
+	if (eventfd_read(pfd->fd, &v) < 0)
+		return;
+	page_offline_run();
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waddress-of-packed-member"
+
+/* Add req to the pending requests, unless its page is there already */
+static int admin_pending_insert(struct offline_req *req)
+{
+	struct rb_node **p = &admin_pending.rb_node;
+	struct rb_node *parent = NULL;
+	struct offline_req *r;
+
+	while (*p) {
+		parent = *p;
+		r = rb_entry(parent, struct offline_req, nd);
+		if (req->addr < r->addr)
+			p = &(*p)->rb_left;
+		else if (req->addr > r->addr)
+			p = &(*p)->rb_right;
+		else
+			return -1;
+	}
+	rb_link_node(&req->nd, parent, p);
+	rb_insert_color(&req->nd, &admin_pending);
+	return 0;
+}
+
+#pragma GCC diagnostic pop
+
+/*
+ * Queue a page for offlining on request of the administrator. hard
+ * forces hard offlining, otherwise the memory-ce-action is used, or soft
+ * offlining if that does not offline. Returns 1 when the page is offline
+ * or queued already, -1 when the kernel cannot offline it.
+ */
+int page_offline_request(u64 addr, int hard)
+{
+	struct offline_req *req;
+	struct mempage *mp;
+	enum otype type;
+
+	addr &= ~((u64)PAGE_SIZE - 1);
+	type = hard ? OFFLINE_HARD : offline > OFFLINE_ACCOUNT ? offline : OFFLINE_SOFT;
+	if (!sysfs_available(kernel_offline[type], W_OK))
+		return -1;
+	mp = mempage_lookup(addr);
+	if (mp && mp->offlined == PAGE_OFFLINE)
+		return 1;
+
+	if (admin_kick_fd < 0) {
+		admin_kick_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+		if (admin_kick_fd < 0 ||
+		    register_pollcb(admin_kick_fd, POLLIN, admin_kick, NULL) < 0) {
+			SYSERRprintf("Cannot set up offline worker");
+			return -1;
+		}
+	}
+	req = xalloc_tag(MEM_PAGE, sizeof(struct offline_req));
+	req->addr = addr;
+	if (admin_pending_insert(req) < 0) {
+		xfree_tag(MEM_PAGE, req);
+		return 1;
+	}
+	req->t = time(NULL);
+	req->type = type;
+	clock_gettime(CLOCK_MONOTONIC, &req->seen);
+	list_add_tail(&req->list, &admin_queue);
+	admin_stats.queued++;
+	if (eventfd_write(admin_kick_fd, 1) < 0)
+		SYSERRprintf("Cannot wake up offline worker");
+	return 0;
+}
+
+static void dump_pages(struct pagedb *db, FILE *f)
 {
 	char *msg;
 	struct rb_node *r;
 	long k;
 
+	if (db->page_src[MEM_SRC_READ] + db->page_src[MEM_SRC_SCRUB] + db->page_src[MEM_SRC_SPARE])
+		fprintf(f, "Corrected page errors by source: read %lu scrub %lu spare %lu other %lu\n\n",
+			db->page_src[MEM_SRC_READ], db->page_src[MEM_SRC_SCRUB],
+			db->page_src[MEM_SRC_SPARE], db->page_src[MEM_SRC_OTHER]);
+
 	k = 0;
-	for (r = rb_first(&mempage_root); r; r = rb_next(r)) { 
+	for (r = rb_first(&db->mempage_root); r; r = rb_next(r)) { 
 		struct mempage *p = rb_entry(r, struct mempage, nd);
 
 		if (k++ == 0)
 			fprintf(f, "Per page corrected memory statistics:\n");
-		msg = bucket_output(&page_trigger_conf, &p->ce.bucket);
+		msg = bucket_output(db->conf, &p->ce.bucket);
 		fprintf(f, "%llx: total %u seen \"%s\" %s%s\n",
 			p->addr,
 			p->ce.count,
@@ -467,21 +1167,111 @@ void dump_page_errors(FILE *f) //outputs current state of memory page errors to
 	}
 }
 
+void dump_page_errors(FILE *f) //outputs current state of memory page errors to a file
+{
+	if (uc_stats.count) {
+		fprintf(f, "Uncorrected patrol scrub pages: %lu (%lu failed)\n",
+			uc_stats.count, uc_stats.failed);
+		fprintf(f, "Read to offline latency: avg %lluus max %lluus\n",
+			uc_stats.total_us / uc_stats.count, uc_stats.max_us);
+		fprintf(f, "Detection to offline latency: avg %llus max %lus\n\n",
+			uc_stats.total_lag / uc_stats.count,
+			(unsigned long)uc_stats.max_lag);
+	}
+
+	dump_cold(f);
+
+	if (live_pages.mp_reclaimed)
+		fprintf(f, "Idle page counters reclaimed: %lu\n\n", live_pages.mp_reclaimed);
+
+	if (admin_stats.queued)
+		fprintf(f, "Pages offlined on request: %lu queued, %lu offlined, %lu failed\n\n",
+			admin_stats.queued, admin_stats.offlined, admin_stats.failed);
+
+	if (soft_stats.deferred) {
+		dump_pressure(f);
+		fprintf(f, "Soft offlines deferred for memory pressure: %lu, %lu waiting, %lu offlined (%lu over %us), %lu failed, max delay %lus\n\n",
+			soft_stats.deferred,
+			soft_stats.deferred - soft_stats.offlined - soft_stats.failed,
+			soft_stats.offlined, soft_stats.overdue, max_defer,
+			soft_stats.failed, (unsigned long)soft_stats.max_delay);
+	}
+
+	dump_pages(&live_pages, f);
+}
+
+void dump_page_errors_db(enum acct_db db, FILE *f)
+{
+	dump_pages(dbs[db], f);
+}
+
+/*
+ * Account page errors in another database than the live one, until
+ * switched back. The others recycle their least recently used pages
+ * when they reach their limit.
+ */
+void page_use(enum acct_db db)
+{
+	pdb = dbs[db];
+}
+
+int page_numpages(enum acct_db db)
+{
+	return dbs[db]->corr_err_counters;
+}
+
+/* Threshold and action of the candidate policy, the live ones where not set */
+void page_candidate_config(int limit)
+{
+	int n;
+
+	candidate_conf = page_trigger_conf;
+	config_trigger("candidate-page", "memory-ce", &candidate_conf);
+	memcpy(candidate_weight, page_weight, sizeof(page_weight));
+	config_weights("candidate-page", "memory-ce", candidate_weight);
+	candidate_offline = offline;
+	n = config_choice("candidate-page", "memory-ce-action", offline_choice);
+	if (n >= 0)
+		candidate_offline = n;
+	candidate_pages.limit = roundup(limit, N);
+	bucket_init(&candidate_pages.mp_repalcement.bucket);
+}
+
 void page_setup(void) //sets up various configurations
 {
 	int n;
 	
 	config_trigger("page", "memory-ce", &page_trigger_conf);
+	config_weights("page", "memory-ce", page_weight);
 	config_trigger("page", "memory-ce-counter-replacement", &mp_replacement_trigger_conf);
+	trigger_template_init(&counter_env);
+	mem_set_evict(MEM_PAGE, page_evict);
+	memcg_setup();
 	n = config_choice("page", "memory-ce-action", offline_choice);
 	if (n >= 0) //choosing offling action
 		offline = n;
-	if (offline > OFFLINE_ACCOUNT && 
+	/* a dry run only reports what it would offline */
+	if (offline > OFFLINE_ACCOUNT && !dry_run &&
 	    !sysfs_available(kernel_offline[offline], W_OK)) {
 		Lprintf("Kernel does not support page offline interface\n");
 		offline = OFFLINE_ACCOUNT;
 	}
 
+	n = config_choice("page", "memory-uc-scrub-action", uc_offline_choice);
+	if (n >= 0)
+		uc_offline = n;
+	if (uc_offline == OFFLINE_HARD && !dry_run &&
+	    !sysfs_available(kernel_offline[OFFLINE_HARD], W_OK)) {
+		Lprintf("Kernel does not support hard page offline interface\n");
+		uc_offline = OFFLINE_ACCOUNT;
+	}
+
+	pressure_setup();
+	config_number("page", "memory-ce-offline-max-defer", "%u", &max_defer);
+	config_number("page", "memory-ce-offline-pace", "%u", &soft_pace);
+	if (!soft_pace)
+		soft_pace = 1;
+
 	page_error_pre_soft_trigger = config_string("page", "memory-pre-sync-soft-ce-trigger");
 
 	if (page_error_pre_soft_trigger && trigger_check(page_error_pre_soft_trigger) < 0) {
@@ -502,5 +1292,20 @@ void page_setup(void) //sets up various configurations
 	if (n != max_corr_err_counters)
 		Lprintf("Round up max-corr-err-counters from %d to %d\n", n, max_corr_err_counters);
 
-	bucket_init(&mp_repalcement.bucket);
+	bucket_init(&live_pages.mp_repalcement.bucket);
+	bucket_init(&shadow_pages.mp_repalcement.bucket);
+
+	cold_pages = max_corr_err_counters * 10;
+	config_number("page", "memory-ce-cold-pages", "%lu", &cold_pages);
+	cold_setup(cold_pages, page_trigger_conf.agetime);
+
+	n = config_bool("page", "memory-ce-idle-expiry");
+	if (n >= 0)
+		page_idle_expiry = n;
+	if (!page_trigger_conf.agetime)
+		page_idle_expiry = 0;
+	if (page_idle_expiry) {
+		page_wheel.check = mempage_idle;
+		wheel_register(&page_wheel);
+	}
 }
@@ -2,8 +2,18 @@
 #include <time.h>
 
 struct memdimm;
-void account_page_error(struct mce *m, int channel, int dimm);
+void account_page_error(struct mce *m, int *channel, int *dimm,
+			enum mem_source src);
+void page_offline_uc(struct mce *m, struct timespec *seen);
+void page_offline_run(void);
+int page_offline_request(u64 addr, int hard);
+unsigned long page_forget(u64 start, u64 end);
+unsigned long page_offlined_count(void);
 void dump_page_errors(FILE *);
+void dump_page_errors_db(enum acct_db db, FILE *f);
+void page_use(enum acct_db db);
+int page_numpages(enum acct_db db);
+void page_candidate_config(int limit);
 void page_setup(void);
 
 
@@ -0,0 +1,342 @@
+/* Track power delivery health per socket.
+
+   PCU machine checks about voltage regulators, ICC_MAX, PMAX calibration
+   and die temperature are classified and counted per socket, together
+   with the thermal throttling reported around them. This explains
+   frequency drops without having to scrape the decoded log. The state
+   of a socket falls back when its events leave the window, checked from
+   the idle expiry wheel.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "trigger.h"
+#include "bitfield.h"
+#include "sysfs.h"
+#include "power.h"
+#include "list.h"
+#include "wheel.h"
+
+/* In increasing order of severity */
+enum power_class { PWR_OTHER, PWR_THERMAL, PWR_PMAX, PWR_ICCMAX, PWR_VR,
+		   MAX_PWR_CLASS };
+
+static const char *power_class_name[] = {
+	[PWR_OTHER] = "other",
+	[PWR_THERMAL] = "thermal",
+	[PWR_PMAX] = "pmax",
+	[PWR_ICCMAX] = "iccmax",
+	[PWR_VR] = "vr",
+};
+
+struct power_socket {
+	struct power_socket *next;
+	int socket;
+	int cpu;			/* last CPU reporting for the socket */
+	unsigned long count[MAX_PWR_CLASS];
+	time_t last[MAX_PWR_CLASS];
+	int state;			/* worst class in window, -1 if none */
+	char queued;			/* on the wheel for the window */
+	struct wheel_node wn;
+	/* thermal throttling */
+	unsigned long throttle;		/* throttle start events */
+	int throttling;
+	time_t last_throttle;
+	unsigned long throttle_count;	/* kernel package_throttle_count */
+	unsigned long correlated;	/* PCU events close to throttling */
+};
+
+static struct power_socket *power_sockets;
+static int power_tracking = 1;
+static unsigned power_window = 24*60*60;
+static unsigned power_correlate = 60;
+static char *power_trigger;
+static struct trigger_template power_env;
+static struct wheel power_wheel;
+
+static time_t power_idle(struct wheel_node *n, time_t now);
+
+void power_setup(void)
+{
+	int n;
+
+	n = config_bool("power", "power-tracking-enabled");
+	if (n >= 0)
+		power_tracking = n;
+	config_number("power", "power-event-window", "%u", &power_window);
+	config_number("power", "power-throttle-window", "%u", &power_correlate);
+	power_trigger = config_string("power", "power-error-trigger");
+	if (power_trigger && trigger_check(power_trigger) < 0) {
+		SYSERRprintf("Cannot access power trigger `%s'", power_trigger);
+		exit(1);
+	}
+	trigger_template_init(&power_env);
+	if (power_tracking) {
+		power_wheel.check = power_idle;
+		wheel_register(&power_wheel);
+	}
+}
+
+/* ICX/SPR/EMR PCU MSCOD bits 24-31 */
+static int pcu_class(unsigned code)
+{
+	switch (code) {
+	case 0x40:
+		return PWR_ICCMAX;
+	case 0x42 ... 0x47:
+	case 0x4A ... 0x4D:
+	case 0x56:
+		return PWR_VR;
+	case 0x2D:
+		return PWR_PMAX;
+	case 0x90:
+		return PWR_THERMAL;
+	default:
+		return PWR_OTHER;
+	}
+}
+
+/* GNR/SRF Punit MSCOD bits 24-31 */
+static int punit_class(unsigned code)
+{
+	switch (code) {
+	case 0x36:
+		return PWR_ICCMAX;
+	case 0x23: case 0x35:
+	case 0x40: case 0x41:
+	case 0x49: case 0x4a:
+	case 0x56:
+		return PWR_VR;
+	case 0x10:
+		return PWR_PMAX;
+	default:
+		return PWR_OTHER;
+	}
+}
+
+static int power_classify(struct mce *m)
+{
+	switch (cputype) {
+	case CPU_ICELAKE_XEON:
+	case CPU_ICELAKE_DE:
+	case CPU_TREMONT_D:
+	case CPU_SAPPHIRERAPIDS:
+	case CPU_EMERALDRAPIDS:
+		if (m->bank != 4)
+			return -1;
+		return pcu_class(EXTRACT(m->status, 24, 31));
+	case CPU_GRANITERAPIDS:
+	case CPU_SIERRAFOREST:
+		if (m->bank != 6)
+			return -1;
+		return punit_class(EXTRACT(m->status, 24, 31));
+	default:
+		return -1;
+	}
+}
+
+static struct power_socket *power_get(int socket)
+{
+	struct power_socket *ps;
+
+	for (ps = power_sockets; ps; ps = ps->next)
+		if (ps->socket == socket)
+			return ps;
+	ps = xalloc(sizeof(struct power_socket));
+	ps->socket = socket;
+	ps->state = -1;
+	ps->next = power_sockets;
+	power_sockets = ps;
+	return ps;
+}
+
+/* Worst class of event seen within the window */
+static int power_state(struct power_socket *ps, time_t now)
+{
+	int i;
+
+	for (i = MAX_PWR_CLASS - 1; i >= 0; i--)
+		if (ps->count[i] && now - ps->last[i] < (time_t)power_window)
+			return i;
+	return -1;
+}
+
+/* When the next event in the window leaves it, 0 if none */
+static time_t power_expires(struct power_socket *ps, time_t now)
+{
+	time_t t, expires = 0;
+	int i;
+
+	for (i = 0; i < MAX_PWR_CLASS; i++) {
+		if (!ps->count[i])
+			continue;
+		t = ps->last[i] + power_window;
+		if (t > now && (!expires || t < expires))
+			expires = t;
+	}
+	return expires;
+}
+
+/* Read the kernel thermal throttle counter of the package, 0 if unknown */
+static unsigned long read_throttle_count(struct power_socket *ps)
+{
+	char base[64];
+
+	snprintf(base, sizeof(base),
+		 "/sys/devices/system/cpu/cpu%d/thermal_throttle", ps->cpu);
+	if (!sysfs_available(base, R_OK))
+		return 0;
+	return read_field_num(base, "package_throttle_count");
+}
+
+/* Returns 1 if the throttle counter increased since the last event */
+static int update_throttle_count(struct power_socket *ps)
+{
+	unsigned long old = ps->throttle_count;
+
+	ps->throttle_count = read_throttle_count(ps);
+	return old && ps->throttle_count > old;
+}
+
+static void power_state_trigger(struct power_socket *ps, int old, time_t t)
+{
+	struct trigger_env env;
+	char *msg;
+	const char *state = ps->state < 0 ? "ok" : power_class_name[ps->state];
+	int i;
+
+	xasprintf(&msg, "Power delivery state of socket %d changed from %s to %s",
+		  ps->socket, old < 0 ? "ok" : power_class_name[old], state);
+	Lprintf("%s\n", msg);
+
+	if (!power_trigger)
+		goto out;
+
+	trigger_env_init(&env, &power_env);
+	trigger_env_add(&env, "MESSAGE=%s", msg);
+	trigger_env_add(&env, "SOCKETID=%d", ps->socket);
+	trigger_env_add(&env, "STATE=%s", state);
+	for (i = 0; i < MAX_PWR_CLASS; i++)
+		trigger_env_add(&env, "COUNT_%s=%lu", power_class_name[i],
+				ps->count[i]);
+	trigger_env_add(&env, "THROTTLECOUNT=%lu", ps->throttle);
+	trigger_env_add(&env, "CORRELATED=%lu", ps->correlated);
+	if (t)
+		trigger_env_add(&env, "LASTEVENT=%lu", (unsigned long)t);
+
+	run_trigger(power_trigger, NULL, trigger_env(&env), false, "power");
+out:
+	free(msg);
+	msg = NULL;
+}
+
+static void power_update(struct power_socket *ps, time_t t)
+{
+	int old = ps->state;
+
+	ps->state = power_state(ps, t);
+	if (ps->state != old)
+		power_state_trigger(ps, old, t);
+}
+
+static time_t power_idle(struct wheel_node *n, time_t now)
+{
+	struct power_socket *ps = container_of(n, struct power_socket, wn);
+	time_t expires;
+
+	power_update(ps, now);
+	expires = power_expires(ps, now);
+	if (!expires)
+		ps->queued = 0;
+	return expires;
+}
+
+static void thermal_event(struct mce *m, time_t t)
+{
+	struct power_socket *ps = power_get(m->socketid);
+
+	ps->cpu = m->extcpu ? m->extcpu : m->cpu;
+	if (m->status & 1) {
+		if (!ps->throttling)
+			ps->throttle++;
+		ps->throttling = 1;
+		ps->last_throttle = t;
+	} else
+		ps->throttling = 0;
+}
+
+void power_event(struct mce *m)
+{
+	struct power_socket *ps;
+	time_t t = m->time;
+	int class, throttled;
+
+	if (!power_tracking)
+		return;
+	if (m->bank == MCE_THERMAL_BANK) {
+		thermal_event(m, t);
+		return;
+	}
+	class = power_classify(m);
+	if (class < 0)
+		return;
+
+	ps = power_get(m->socketid);
+	ps->cpu = m->extcpu ? m->extcpu : m->cpu;
+	ps->count[class]++;
+	ps->last[class] = t;
+
+	throttled = update_throttle_count(ps);
+	if (ps->throttling || throttled ||
+	    (ps->last_throttle && t - ps->last_throttle < (time_t)power_correlate))
+		ps->correlated++;
+
+	power_update(ps, t);
+	if (!ps->queued) {
+		ps->queued = 1;
+		wheel_add(&power_wheel, &ps->wn, t + power_window);
+	}
+}
+
+void dump_power(FILE *f)
+{
+	struct power_socket *ps;
+	time_t now = time(NULL);
+	int i, state;
+	unsigned long throttle_count;
+
+	for (ps = power_sockets; ps; ps = ps->next) {
+		/* the wheel reports the change when its tick comes up */
+		state = power_state(ps, now);
+		throttle_count = read_throttle_count(ps);
+		fprintf(f, "socket %d state %s\n", ps->socket,
+			state < 0 ? "ok" : power_class_name[state]);
+		for (i = MAX_PWR_CLASS - 1; i >= 0; i--) {
+			if (!ps->count[i])
+				continue;
+			fprintf(f, "\t%s %lu last %lds ago\n", power_class_name[i],
+				ps->count[i], (long)(now - ps->last[i]));
+		}
+		fprintf(f, "\tthrottle %lu%s package_throttle_count %lu correlated %lu\n",
+			ps->throttle, ps->throttling ? " (active)" : "",
+			throttle_count, ps->correlated);
+	}
+}
@@ -0,0 +1,3 @@
+void power_setup(void);
+void power_event(struct mce *m);
+void dump_power(FILE *f);
@@ -0,0 +1,187 @@
+/* Memory pressure of the system, for pacing soft page offlines.
+
+   A soft offline makes the kernel migrate the page. While compaction or
+   NUMA balancing already migrate a lot, or tasks stall on memory, extra
+   migrations add to the storm and to the tail latency of the workload.
+   The migration and compaction stall counters of /proc/vmstat and the
+   memory pressure stall information of /proc/pressure/memory are
+   sampled at most once a second to tell when that is the case. The
+   counters give rates only over a short window: after a quiet period
+   the first sample is a new start and the pressure is unknown until the
+   next one, which the offline worker takes a second later.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mcelog.h"
+#include "config.h"
+#include "pressure.h"
+
+#define VMSTAT "/proc/vmstat"
+#define PSI_MEMORY "/proc/pressure/memory"
+
+enum {
+	RATE_WINDOW = 3,	/* max seconds between samples for a rate */
+};
+
+static int pressure_enabled = 1;
+static double psi_threshold = 10;	/* percent of time stalled, avg10 */
+static unsigned long migrate_threshold = 10000;	/* pages per second */
+static unsigned long compact_threshold = 10;	/* stalls per second */
+
+static struct timespec last;
+static unsigned long long last_migrate, last_compact;
+static enum pressure state;
+static const char *state_name[] = {
+	[PRESSURE_NORMAL] = "normal",
+	[PRESSURE_HIGH] = "high",
+	[PRESSURE_UNKNOWN] = "unknown",
+};
+static int have_vmstat, have_psi;
+
+/* latest sample */
+static double psi_some;
+static unsigned long migrate_rate, compact_rate;
+static unsigned long samples, high_samples;
+
+static int read_vmstat(unsigned long long *migrate, unsigned long long *compact)
+{
+	char *line = NULL;
+	size_t linelen = 0;
+	unsigned long long v;
+	char name[64];
+	FILE *f;
+	int n = 0;
+
+	f = fopen(VMSTAT, "re");
+	if (!f)
+		return -1;
+	while (getline(&line, &linelen, f) > 0) {
+		if (sscanf(line, "%63s %llu", name, &v) != 2)
+			continue;
+		if (!strcmp(name, "pgmigrate_success")) {
+			*migrate = v;
+			n++;
+		} else if (!strcmp(name, "compact_stall")) {
+			*compact = v;
+			n++;
+		}
+	}
+	free(line);
+	fclose(f);
+	return n == 2 ? 0 : -1;
+}
+
+static int read_psi(double *some)
+{
+	char *line = NULL;
+	size_t linelen = 0;
+	FILE *f;
+	int ret = -1;
+
+	f = fopen(PSI_MEMORY, "re");
+	if (!f)
+		return -1;
+	while (getline(&line, &linelen, f) > 0) {
+		if (sscanf(line, "some avg10=%lf", some) == 1) {
+			ret = 0;
+			break;
+		}
+	}
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+static void pressure_sample(struct timespec *now)
+{
+	unsigned long long migrate = 0, compact = 0;
+	unsigned long long ms;
+	int fresh;
+
+	ms = (now->tv_sec - last.tv_sec) * 1000ULL +
+		(now->tv_nsec - last.tv_nsec) / 1000000;
+	fresh = last.tv_sec && ms && ms <= RATE_WINDOW * 1000;
+	state = PRESSURE_NORMAL;
+	if (have_vmstat && read_vmstat(&migrate, &compact) == 0) {
+		if (fresh) {
+			migrate_rate = (migrate - last_migrate) * 1000 / ms;
+			compact_rate = (compact - last_compact) * 1000 / ms;
+			if (migrate_rate >= migrate_threshold ||
+			    compact_rate >= compact_threshold)
+				state = PRESSURE_HIGH;
+		} else
+			state = PRESSURE_UNKNOWN;
+		last_migrate = migrate;
+		last_compact = compact;
+	}
+	/* averaged by the kernel, good from the first sample */
+	if (have_psi && read_psi(&psi_some) == 0 && psi_some >= psi_threshold)
+		state = PRESSURE_HIGH;
+	last = *now;
+	if (state == PRESSURE_UNKNOWN)
+		return;
+	samples++;
+	if (state == PRESSURE_HIGH)
+		high_samples++;
+}
+
+/* Is the system migrating a lot or stalled on memory right now? */
+enum pressure pressure_state(void)
+{
+	struct timespec now;
+
+	if (!pressure_enabled)
+		return PRESSURE_NORMAL;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (!last.tv_sec || now.tv_sec > last.tv_sec)
+		pressure_sample(&now);
+	return state;
+}
+
+void dump_pressure(FILE *f)
+{
+	if (!pressure_enabled || !samples)
+		return;
+	fprintf(f, "Memory pressure: %s, psi some avg10 %.2f, migrations %lu/s, compaction stalls %lu/s\n",
+		state_name[state], psi_some, migrate_rate, compact_rate);
+	fprintf(f, "Memory pressure samples: %lu, %lu high\n", samples, high_samples);
+}
+
+void pressure_setup(void)
+{
+	unsigned long long migrate, compact;
+	double some;
+	int n;
+
+	n = config_bool("page", "memory-ce-offline-pacing");
+	if (n >= 0)
+		pressure_enabled = n;
+	if (!pressure_enabled)
+		return;
+	config_number("page", "memory-ce-offline-psi-threshold", "%lf", &psi_threshold);
+	config_number("page", "memory-ce-offline-migrate-threshold", "%lu", &migrate_threshold);
+	config_number("page", "memory-ce-offline-compact-threshold", "%lu", &compact_threshold);
+	have_vmstat = read_vmstat(&migrate, &compact) == 0;
+	have_psi = read_psi(&some) == 0;
+	if (!have_vmstat && !have_psi) {
+		Lprintf("Cannot read %s or %s, no pacing of page offlines\n",
+			VMSTAT, PSI_MEMORY);
+		pressure_enabled = 0;
+	}
+}
@@ -0,0 +1,11 @@
+#include <stdio.h>
+
+enum pressure {
+	PRESSURE_NORMAL,
+	PRESSURE_HIGH,
+	PRESSURE_UNKNOWN,	/* no recent sample to compare with */
+};
+
+void pressure_setup(void);
+enum pressure pressure_state(void);
+void dump_pressure(FILE *f);
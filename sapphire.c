@@ -22,6 +22,7 @@
 #include "bitfield.h"
 #include "sapphire.h"
 #include "memdb.h"
+#include "health.h"
 
 static char *pcu_1[] = {
 	[0x0D] = "MCA_LLC_BIST_ACTIVE_TIMEOUT",
@@ -337,10 +338,10 @@ static void sapphire_imc_misc(bool hbm, u64 status, u64 misc)
 		case 1: Wprintf("SDDC\n"); break;
 		case 2: Wprintf("SDDC+1 2LM memory mode\n"); break;
 		case 3: Wprintf("SDDC+1\n"); break;
-		case 4: Wprintf("ADDDC 2LM memory mode\n"); break;
-		case 5: Wprintf("ADDDC\n"); break;
-		case 6: Wprintf("ADDDC+1 2LM memory mode\n"); break;
-		case 7: Wprintf("ADDDC+1\n"); break;
+		case 4: Wprintf("ADDDC 2LM memory mode\n"); health_adddc(); break;
+		case 5: Wprintf("ADDDC\n"); health_adddc(); break;
+		case 6: Wprintf("ADDDC+1 2LM memory mode\n"); health_adddc(); break;
+		case 7: Wprintf("ADDDC+1\n"); health_adddc(); break;
 		case 8: Wprintf("DDRT read\n"); break;
 		default: Wprintf("unknown\n"); break;
 		}
@@ -470,5 +471,13 @@ void sapphire_memerr_misc(struct mce *m, int *channel, int *dimm)
 	case 30 ... 31:
 		channel[0] = 8 + m->bank - 30;
 		break;
+	default:
+		return;
 	}
+
+	/* failed DRAM device of a corrected error */
+	if ((status & MCI_STATUS_MISCV) && !EXTRACT(m->misc, 63, 63))
+		memdb_device_error(m, channel[0], dimm[0], EXTRACT(m->misc, 56, 58),
+				   m->bank >= 30 ? EXTRACT(m->misc, 51, 55) :
+				   EXTRACT(m->misc, 43, 48));
 }
@@ -38,6 +38,14 @@
 #include "memutil.h"
 #include "paths.h"
 #include "page.h"
+#include "interconnect.h"
+#include "power.h"
+#include "memcg.h"
+#include "ingest.h"
+#include "trace.h"
+#include "inject.h"
+#include "candidate.h"
+#include "cxl.h"
 
 #define PAIR(x) x, sizeof(x)-1
 
@@ -47,33 +55,52 @@ struct clientcon {
 	char *outbuf;
 	size_t outcur;
 	size_t outlen;
+	char *pending;	/* incomplete last command line */
+	size_t pendlen, pendsize;
+	int discard;	/* dropping the rest of a line that was too long */
+	int eof;	/* the client sent all its commands */
+	int admin;
+	int fd;
+	struct mce *inject;	/* synthetic record to inject after the reply */
+	unsigned inject_count;
+	int waiting;		/* for the inject report */
+};
+
+enum {
+	MAX_PENDING = 4 << 20,	/* longest command line */
+	MAX_INJECT = 1000,	/* synthetic records per inject command */
 };
 
 static char *client_path = SOCKET_PATH;
 static int initial_ping_timeout = 2;
 static struct config_cred acc = { .uid = 0, .gid = -1U };
+static struct config_cred admin_acc = { .uid = 0, .gid = -1U };
 
 static void free_outbuf(struct clientcon *cc)
 {
-	free(cc->outbuf);
+	xfree_tag(MEM_CLIENT, cc->outbuf);
 	cc->outbuf = NULL;
 	cc->outcur = cc->outlen = 0;
 }
 
 static void free_inbuf(struct clientcon *cc)
 {
-	free(cc->inbuf);
+	xfree_tag(MEM_CLIENT, cc->inbuf);
 	cc->inbuf = NULL;
 	cc->inptr = NULL;
 }
 
 static void free_cc(struct clientcon *cc)
 {
-	free(cc->outbuf);
+	xfree_tag(MEM_CLIENT, cc->outbuf);
 	cc->outbuf = NULL;
-	free(cc->inbuf);
+	xfree_tag(MEM_CLIENT, cc->inbuf);
 	cc->inbuf = NULL;
-	free(cc);
+	xfree_tag(MEM_CLIENT, cc->pending);
+	cc->pending = NULL;
+	xfree_tag(MEM_CLIENT, cc->inject);
+	cc->inject = NULL;
+	xfree_tag(MEM_CLIENT, cc);
 	cc = NULL;
 }
 
@@ -86,10 +113,15 @@ static void dispatch_dump(FILE *fh, char *s)
 {
 	char *p;
 	enum printflags printflags = 0;
+	enum acct_db db = DB_LIVE;
 
 	while ((p = strsep(&s, " ")) != NULL) {
 		if (!strcmp(p, "dump"))
 			;
+		else if (!strcmp(p, "shadow"))
+			db = DB_SHADOW;
+		else if (!strcmp(p, "candidate"))
+			db = DB_CANDIDATE;
 		else if (!strcmp(p, "bios"))
 			printflags |= DUMP_BIOS;
 		else if (!strcmp(p, "all"))
@@ -98,26 +130,260 @@ static void dispatch_dump(FILE *fh, char *s)
 			fprintf(fh, "Unknown dump parameter\n");
 	}			
 
-	dump_memory_errors(fh, printflags);
+	if (db != DB_LIVE)
+		dump_memory_errors_db(db, fh, printflags | DUMP_ALL);
+	else
+		dump_memory_errors(fh, printflags);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_pages(FILE *fh, char *s)
+{
+	if (!strcmp(s, "pages shadow"))
+		dump_page_errors_db(DB_SHADOW, fh);
+	else if (!strcmp(s, "pages candidate"))
+		dump_page_errors_db(DB_CANDIDATE, fh);
+	else
+		dump_page_errors(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_candidate(FILE *fh)
+{
+	dump_candidate(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_links(FILE *fh)
+{
+	dump_links(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_power(FILE *fh)
+{
+	dump_power(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_cgroups(FILE *fh)
+{
+	dump_memcg(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_memstats(FILE *fh)
+{
+	dump_memstats(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_ingest(FILE *fh)
+{
+	dump_ingest(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_cxl(FILE *fh)
+{
+	dump_cxl(fh);
+	fprintf(fh, "done\n");
+}
+
+static void dispatch_trace(FILE *fh)
+{
+	dump_trace(fh);
+	fprintf(fh, "done\n");
+}
+
+static int parse_addr(char *s, u64 *addr)
+{
+	char *end;
+
+	*addr = strtoull(s, &end, 0);
+	return *end == 0 && end != s ? 0 : -1;
+}
+
+/* offline [soft|hard] addr... */
+static void dispatch_offline(FILE *fh, char *s)
+{
+	unsigned long queued = 0, already = 0, invalid = 0;
+	int hard = 0, ret;
+	char *p;
+	u64 addr;
+
+	strsep(&s, " ");
+	while ((p = strsep(&s, " \t")) != NULL) {
+		if (*p == 0)
+			continue;
+		if (!strcmp(p, "hard") || !strcmp(p, "soft")) {
+			hard = !strcmp(p, "hard");
+			continue;
+		}
+		if (parse_addr(p, &addr) < 0) {
+			invalid++;
+			continue;
+		}
+		ret = page_offline_request(addr, hard);
+		if (ret < 0) {
+			fprintf(fh, "Kernel does not support page offline interface\n");
+			break;
+		}
+		if (ret > 0)
+			already++;
+		else
+			queued++;
+	}
+	fprintf(fh, "offline: %lu queued %lu already offline %lu invalid\n",
+		queued, already, invalid);
+	fprintf(fh, "done\n");
+}
+
+/* reset dimm socket/channel/dimm... */
+static void dispatch_reset(FILE *fh, char *s)
+{
+	int socketid, channel, dimm;
+	char *p;
+
+	strsep(&s, " ");
+	p = strsep(&s, " ");
+	if (!p || strcmp(p, "dimm")) {
+		fprintf(fh, "Unknown reset parameter\n");
+		fprintf(fh, "done\n");
+		return;
+	}
+	while ((p = strsep(&s, " \t")) != NULL) {
+		if (*p == 0)
+			continue;
+		if (sscanf(p, "%d/%d/%d", &socketid, &channel, &dimm) != 3 ||
+		    memdb_reset(socketid, channel, dimm) < 0)
+			fprintf(fh, "Unknown DIMM %s\n", p);
+		else
+			Lprintf("Counters of DIMM %s reset on request\n", p);
+	}
 	fprintf(fh, "done\n");
 }
 
-static void dispatch_pages(FILE *fh)
+/* forget page start[-end]... */
+static void dispatch_forget(FILE *fh, char *s)
 {
-	dump_page_errors(fh);
+	unsigned long n = 0;
+	char *p, *end;
+	u64 start, last;
+
+	strsep(&s, " ");
+	p = strsep(&s, " ");
+	if (!p || strcmp(p, "page")) {
+		fprintf(fh, "Unknown forget parameter\n");
+		fprintf(fh, "done\n");
+		return;
+	}
+	while ((p = strsep(&s, " \t")) != NULL) {
+		if (*p == 0)
+			continue;
+		end = strchr(p, '-');
+		if (end)
+			*end++ = 0;
+		if (parse_addr(p, &start) < 0 ||
+		    (end && parse_addr(end, &last) < 0)) {
+			fprintf(fh, "Invalid page range %s\n", p);
+			continue;
+		}
+		n += page_forget(start, end ? last : start | 0xfff);
+	}
+	fprintf(fh, "forget: %lu pages\n", n);
 	fprintf(fh, "done\n");
 }
 
-static void dispatch_commands(char *line, FILE *fh)
+/* inject [count n] [status s] [addr a] [misc m] [bank b] [socket s] [cpu c] */
+static void dispatch_inject(FILE *fh, char *s, struct clientcon *cc)
+{
+	struct mce m;
+	unsigned count = 1;
+	char *p, *v;
+	u64 val;
+
+	if (cc->inject || cc->waiting) {
+		fprintf(fh, "inject: busy\ndone\n");
+		return;
+	}
+	inject_default(&m);
+	strsep(&s, " ");
+	while ((p = strsep(&s, " \t")) != NULL) {
+		if (*p == 0)
+			continue;
+		v = strsep(&s, " \t");
+		if (!v || parse_addr(v, &val) < 0) {
+			fprintf(fh, "inject: missing or invalid value for %s\ndone\n", p);
+			return;
+		}
+		if (!strcmp(p, "count") && val >= 1 && val <= MAX_INJECT)
+			count = val;
+		else if (!strcmp(p, "status"))
+			m.status = val;
+		else if (!strcmp(p, "addr"))
+			m.addr = val;
+		else if (!strcmp(p, "misc"))
+			m.misc = val;
+		else if (!strcmp(p, "bank"))
+			m.bank = val;
+		else if (!strcmp(p, "socket"))
+			m.socketid = val;
+		else if (!strcmp(p, "cpu"))
+			m.extcpu = val;
+		else {
+			fprintf(fh, "inject: invalid parameter %s %s\ndone\n", p, v);
+			return;
+		}
+	}
+	/* queued once the output so far is complete, the report follows it */
+	cc->inject = xalloc_tag(MEM_CLIENT, sizeof(struct mce));
+	*cc->inject = m;
+	cc->inject_count = count;
+}
+
+static int admin_command(char *s)
+{
+	return !strncmp(s, "offline", 7) || !strncmp(s, "reset", 5) ||
+		!strncmp(s, "forget", 6) || !strncmp(s, "inject", 6);
+}
+
+static void dispatch_commands(char *line, FILE *fh, struct clientcon *cc)
 {
 	char *s;
 	while ((s = strsep(&line, "\n")) != NULL) { 
 		while (isspace(*s))
 			line++;
-		if (!strncmp(s, "dump", 4))
+		if (admin_command(s) && !cc->admin)
+			fprintf(fh, "permission denied\ndone\n");
+		else if (!strncmp(s, "inject", 6))
+			dispatch_inject(fh, s, cc);
+		else if (!strncmp(s, "offline", 7))
+			dispatch_offline(fh, s);
+		else if (!strncmp(s, "reset", 5))
+			dispatch_reset(fh, s);
+		else if (!strncmp(s, "forget", 6))
+			dispatch_forget(fh, s);
+		else if (!strncmp(s, "dump", 4))
 			dispatch_dump(fh, s);
 		else if (!strncmp(s, "pages", 5))
-			dispatch_pages(fh);
+			dispatch_pages(fh, s);
+		else if (!strncmp(s, "links", 5))
+			dispatch_links(fh);
+		else if (!strncmp(s, "power", 5))
+			dispatch_power(fh);
+		else if (!strncmp(s, "cgroups", 7))
+			dispatch_cgroups(fh);
+		else if (!strncmp(s, "memstats", 8))
+			dispatch_memstats(fh);
+		else if (!strncmp(s, "ingest", 6))
+			dispatch_ingest(fh);
+		else if (!strncmp(s, "trace", 5))
+			dispatch_trace(fh);
+		else if (!strncmp(s, "candidate", 9))
+			dispatch_candidate(fh);
+		else if (!strncmp(s, "cxl", 3))
+			dispatch_cxl(fh);
 		else if (!strcmp(s, "ping"))
 			fprintf(fh, "pong\n");
 		else if (*s != 0)
@@ -125,23 +391,126 @@ static void dispatch_commands(char *line, FILE *fh)
 	}
 }
 
-/* assumes commands don't cross records */
+/* Add to the output of a client outside of its request */
+static void append_output(struct clientcon *cc, char *s)
+{
+	size_t n = strlen(s);
+
+	cc->outbuf = xrealloc_tag(MEM_CLIENT, cc->outbuf, cc->outlen + n + 1);
+	memcpy(cc->outbuf + cc->outlen, s, n + 1);
+	cc->outlen += n;
+	set_pollcb_events(cc->fd, POLLOUT);
+}
+
+static void inject_done(void *data, char *report)
+{
+	struct clientcon *cc = data;
+
+	cc->waiting = 0;
+	append_output(cc, report);
+}
+
+static void start_inject(struct clientcon *cc)
+{
+	cc->waiting = 1;
+	if (inject_start(cc->inject, cc->inject_count, inject_done, cc) < 0) {
+		cc->waiting = 0;
+		append_output(cc, "inject: busy\ndone\n");
+	}
+	xfree_tag(MEM_CLIENT, cc->inject);
+	cc->inject = NULL;
+}
+
+/* Keep an incomplete command line until the rest arrives */
+static void pending_add(struct clientcon *cc, char *str, size_t n)
+{
+	if (cc->pendlen + n + 1 > cc->pendsize) {
+		cc->pendsize = (cc->pendlen + n + 1) * 2;
+		cc->pending = xrealloc_tag(MEM_CLIENT, cc->pending, cc->pendsize);
+	}
+	memcpy(cc->pending + cc->pendlen, str, n);
+	cc->pendlen += n;
+	cc->pending[cc->pendlen] = 0;
+}
+
+static char *pending_take(struct clientcon *cc)
+{
+	char *p = cc->pending;
+
+	cc->pending = NULL;
+	cc->pendlen = cc->pendsize = 0;
+	return p;
+}
+
+/*
+ * Commands can cross records, e.g. an offline command with thousands of
+ * addresses: the incomplete last line is kept until the rest arrives, or
+ * run when the client is done sending.
+ */
 static void process_cmd(struct clientcon *cc)
 {
 	FILE *fh;
+	char *line = cc->inbuf ? cc->inbuf : "", *tail, *cmds, *own = NULL;
+	size_t tlen;
+	int toolong = 0;
+	unsigned long long start = trace_begin();
+
+	if (cc->discard) {
+		char *nl = strchr(line, '\n');
+
+		if (!nl)
+			return;
+		line = nl + 1;
+		cc->discard = 0;
+	}
+	tail = strrchr(line, '\n');
+	tail = tail ? tail + 1 : line;
+	tlen = strlen(tail);
+	if (tail == line && !cc->eof) {
+		/* no end of line yet */
+		if (cc->pendlen + tlen < MAX_PENDING) {
+			pending_add(cc, line, tlen);
+			return;
+		}
+		xfree_tag(MEM_CLIENT, pending_take(cc));
+		toolong = cc->discard = 1;
+		cmds = "";
+	} else if (cc->pending) {
+		pending_add(cc, line, cc->eof ? tail + tlen - line : tail - line);
+		cmds = own = pending_take(cc);
+	} else
+		cmds = line;
+	if (!toolong && *tail && !cc->eof) {
+		if (tlen < MAX_PENDING)
+			pending_add(cc, tail, tlen);
+		else
+			toolong = cc->discard = 1;
+		*tail = 0;
+	}
+	if (*cmds == 0 && !toolong) {
+		xfree_tag(MEM_CLIENT, own);
+		return;
+	}
 
 	assert(cc->outbuf == NULL);
 	fh = open_memstream(&cc->outbuf, &cc->outlen);
 	if (!fh)
 		Enomem();
 	cc->outcur = 0;
-	dispatch_commands(cc->inbuf, fh);
+	dispatch_commands(cmds, fh, cc);
+	xfree_tag(MEM_CLIENT, own);
+	if (toolong)
+		fprintf(fh, "command too long\ndone\n");
 	if (ferror(fh) || fclose(fh) != 0)
 		Enomem();
+	mem_track(MEM_CLIENT, cc->outbuf);
+	trace_end("client request", start, cc->outlen);
+	if (cc->inject)
+		start_inject(cc);
 }
 
 /* check if client is allowed to access */
-static int access_check(int fd, struct msghdr *msg)
+static int access_check(int fd, struct msghdr *msg, struct clientcon *cc)
 {
 	struct cmsghdr *cmsg;	
 	struct ucred *uc;
@@ -156,6 +525,9 @@ static int access_check(int fd, struct msghdr *msg)
 		return -1;
 	}
 	uc = (struct ucred *)CMSG_DATA(cmsg);
+	cc->admin = uc->uid == 0 ||
+		(admin_acc.uid != -1U && uc->uid == admin_acc.uid) ||
+		(admin_acc.gid != -1U && uc->gid == admin_acc.gid);
 	if (uc->uid == 0 || 
 		(acc.uid != -1U && uc->uid == acc.uid) ||
 		(acc.gid != -1U && uc->gid == acc.gid))
@@ -185,7 +557,7 @@ static int client_input(int fd, struct clientcon *cc)
 	if (n == 0)
 		return 0;
 
-	cc->inbuf = xalloc_nonzero(n + 1);
+	cc->inbuf = xalloc_nonzero_tag(MEM_CLIENT, n + 1);
 	cc->inbuf[n] = 0;
 	cc->inptr = cc->inbuf;
 
@@ -195,7 +567,7 @@ static int client_input(int fd, struct clientcon *cc)
 	if (n2 < n)
 		return -1;
 
-	return access_check(fd, &msg) == 0 ? n : -1;
+	return access_check(fd, &msg, cc) == 0 ? n : -1;
 }
 
 /* process input/out on client socket */
@@ -205,9 +577,6 @@ static void client_event(struct pollfd *pfd, void *data)
 	struct clientcon *cc = (struct clientcon *)data;
 	int n;
 
-	if (events & ~(POLLIN|POLLOUT)) /* error/close */
-		goto error;
-
 	if (events & POLLOUT) {
 		if (cc->outcur < cc->outlen) {
 			n = send(pfd->fd, cc->outbuf + cc->outcur, 
@@ -226,15 +595,29 @@ static void client_event(struct pollfd *pfd, void *data)
 		n = client_input(pfd->fd, cc);
 		if (n < 0)
 			goto error;
+		if (n == 0)
+			cc->eof = 1;
+	}
+	/* run what came before the hangup, there is nobody to answer */
+	if (events & ~(POLLIN|POLLOUT))
+		cc->eof = 1;
+	if (cc->inbuf || (cc->eof && cc->pending)) {
 		process_cmd(cc);
 		free_inbuf(cc);
 	}
-	pfd->events = cc->outbuf ? POLLOUT : POLLIN;
+	if (events & ~(POLLIN|POLLOUT))
+		goto error;
+	if (cc->eof && !cc->outbuf && !cc->waiting)
+		goto error;
+	/* no more commands until the inject report was sent */
+	pfd->events = cc->outbuf ? POLLOUT : cc->waiting ? 0 : POLLIN;
 	return;
 
 error:
 	if (pfd->revents & POLLERR)
 		SYSERRprintf("error while reading from client");
+	if (cc->waiting)
+		inject_cancel(cc);
 	close(pfd->fd);
 	unregister_pollcb(pfd);
 	free_cc(cc);
@@ -258,7 +641,8 @@ static void client_accept(struct pollfd *pfd, void *data)
 		goto cleanup;
 	}
 
-	cc = xalloc(sizeof(struct clientcon));
+	cc = xalloc_tag(MEM_CLIENT, sizeof(struct clientcon));
+	cc->fd = nfd;
 	if (register_pollcb(nfd, POLLIN, client_event, cc) < 0) {
 		sendstring(nfd, "mcelog server too busy\n");
 		goto cleanup;
@@ -266,7 +650,7 @@ static void client_accept(struct pollfd *pfd, void *data)
 	return;
 
 cleanup:
-	free(cc);
+	xfree_tag(MEM_CLIENT, cc);
 	cc = NULL;
 	close(nfd);
 }
@@ -277,6 +661,7 @@ static void server_config(void)
 	long v;
 
 	config_cred("server", "client", &acc);
+	config_cred("server", "admin", &admin_acc);
 	if ((s = config_string("server", "socket-path")) != NULL)
 		client_path = s;
 	if (config_number("server", "initial-ping-timeout", "%u", &v) == 0)
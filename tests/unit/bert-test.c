@@ -0,0 +1,75 @@
+/* Boot error memory sections going through the merge, and bad regions */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "mcelog.h"
+#include "config.h"
+#include "memdb.h"
+#include "msg.h"
+#include "ingest.h"
+#include "bert.h"
+
+static struct ingest_source dev = { .name = "device" };
+static struct ingest_source mce = { .name = "bert" };
+
+static void emit(struct ingest_source *s, struct mce *m, unsigned recordlen,
+		 int index)
+{
+	(void)recordlen;
+	printf("released %s %d\n", s->name, index);
+	if (s->process)
+		s->process(m, index);
+}
+
+static void queue(struct mce *m)
+{
+	ingest_push(&mce, m, sizeof(struct mce), mce.records);
+}
+
+/* One error status block whose raw data reaches far past the region */
+static void truncated(void)
+{
+	static const char name[] = "bert-test.bin";
+	u32 es[5] = { 1, 20, 0xffffffff, 0, 2 };
+	FILE *f;
+
+	f = fopen(name, "w");
+	fwrite(es, sizeof(es), 1, f);
+	fclose(f);
+	printf("decode returned %d\n", bert_decode(name, NULL));
+	unlink(name);
+}
+
+int main(void)
+{
+	syslog_opt = 0;
+	setenv("TZ", "UTC", 1);
+	tzset();
+	parse_config_file("bert-test.conf");
+	unlink("bert-test.state");
+	memdb_config();
+	ingest_setup(emit);
+	ingest_register(&dev);
+	ingest_start();
+
+	printf("-- held back by the device\n");
+	ingest_register(&mce);
+	bert_setup(queue);
+	ingest_close(&mce);
+	fflush(stdout);
+
+	printf("-- device caught up\n");
+	ingest_advance(&dev, time(NULL));
+	ingest_run();
+	fflush(stdout);
+
+	printf("-- truncated region\n");
+	fflush(stdout);
+	truncated();
+
+	unlink("bert-test.state");
+	return 0;
+}
@@ -0,0 +1,65 @@
+/* Encoding of the cold page tier and the counts it gives back */
+#include <stdio.h>
+#include <time.h>
+#include "mcelog.h"
+#include "coldpage.h"
+
+enum { PAGES = 500 };
+
+/* spread the frames so that the deltas need one to six varint bytes */
+static u64 pfn_of(int i)
+{
+	return 0x1000 + (u64)i * i * i * i * 1237;
+}
+
+static void take(u64 pfn)
+{
+	unsigned count, total;
+	time_t t;
+
+	if (cold_take(pfn, &count, &total, &t))
+		printf("pfn %llx: count %u total %u\n", pfn, count, total);
+	else
+		printf("pfn %llx: not in the cold tier\n", pfn);
+}
+
+int main(void)
+{
+	time_t now = time(NULL);
+	unsigned count, total;
+	time_t t;
+	int i, bad = 0;
+
+	cold_setup(10000, 24*60*60);
+
+	printf("-- bucket and lifetime counts\n");
+	cold_put(0x10, 3, 300, now);
+	cold_put(0x11, 255, 70000, now);
+	cold_put(0x12, 1000, 1000, now);
+	take(0x10);
+	take(0x11);
+	take(0x12);
+	take(0x10);
+
+	printf("-- many pages over split blocks\n");
+	for (i = 0; i < PAGES; i++)
+		cold_put(pfn_of(i), 1 + i % 200, 1 + i * 1000, now);
+	dump_cold(stdout);
+	for (i = PAGES - 1; i >= 0; i--) {
+		if (!cold_take(pfn_of(i), &count, &total, &t) ||
+		    count != 1U + i % 200 || total != 1U + i * 1000U) {
+			printf("pfn %llx: wrong counts\n", pfn_of(i));
+			bad++;
+		}
+	}
+	printf("%d pages read back, %d wrong\n", PAGES, bad);
+
+	printf("-- forget a range\n");
+	cold_put(0x20, 1, 1, now);
+	cold_put(0x21, 1, 1, now);
+	cold_put(0x30, 2, 2, now);
+	printf("forgot %lu\n", cold_forget(0x20, 0x2f));
+	take(0x21);
+	take(0x30);
+	return 0;
+}
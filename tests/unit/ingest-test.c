@@ -0,0 +1,87 @@
+/* Merging, deduplication and late records of the ingest sources */
+#include <stdio.h>
+#include <string.h>
+#include "mcelog.h"
+#include "ingest.h"
+
+static struct ingest_source a = { .name = "a" };
+static struct ingest_source b = { .name = "b" };
+
+static void emit(struct ingest_source *s, struct mce *m, unsigned recordlen,
+		 int index)
+{
+	(void)recordlen;
+	printf("released %s %d time %llu\n", s->name, index, m->time);
+}
+
+static void push(struct ingest_source *s, int index, unsigned long long t)
+{
+	struct mce m;
+
+	memset(&m, 0, sizeof(struct mce));
+	m.status = MCI_STATUS_VAL|MCI_STATUS_EN;
+	m.time = t;
+	m.tsc = t;
+	ingest_push(s, &m, sizeof(struct mce), index);
+}
+
+/* b has read everything up to time 100 when asked */
+static void b_catch_up(struct ingest_source *s)
+{
+	printf("catch up %s\n", s->name);
+	ingest_advance(s, 100);
+}
+
+static void stats(struct ingest_source *s)
+{
+	printf("%s: records %lu queued %u duplicates %lu late %lu forced %lu\n",
+	       s->name, s->records, s->queued, s->duplicates, s->late, s->forced);
+}
+
+int main(void)
+{
+	ingest_setup(emit);
+	ingest_register(&a);
+	ingest_register(&b);
+	ingest_start();
+
+	printf("-- merge\n");
+	push(&a, 1, 10);
+	push(&a, 2, 30);
+	push(&b, 3, 20);
+	ingest_advance(&a, 30);
+	ingest_advance(&b, 25);
+	ingest_run();
+
+	printf("-- idle source caught up\n");
+	push(&a, 4, 40);
+	ingest_advance(&a, 40);
+	b.catch_up = b_catch_up;
+	ingest_run();
+	b.catch_up = NULL;
+
+	printf("-- duplicate\n");
+	push(&a, 5, 50);
+	push(&b, 6, 50);
+	ingest_advance(&a, 50);
+	ingest_run();
+
+	printf("-- late\n");
+	push(&b, 7, 45);
+	ingest_run();
+
+	printf("-- forced\n");
+	a.limit = 2;
+	push(&a, 8, 200);
+	push(&a, 9, 201);
+	push(&a, 10, 202);
+	ingest_advance(&a, 202);
+	ingest_run();
+
+	printf("-- closed\n");
+	ingest_close(&b);
+
+	stats(&a);
+	stats(&b);
+	return 0;
+}
@@ -0,0 +1,70 @@
+/* The page database under a memory limit, and after it has room again */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mcelog.h"
+#include "config.h"
+#include "memdb.h"
+#include "memutil.h"
+#include "msg.h"
+#include "page.h"
+
+static u64 next_addr = 0x100000;
+
+/*
+ * A corrected error on n pages not seen before. The log is shown without
+ * the page counts, which depend on the size of a page counter.
+ */
+static void errors(int n)
+{
+	int channel[2] = { -1, -1 }, dimm[2] = { -1, -1 };
+	char *buf, *line, *save;
+	size_t len;
+	struct mce m;
+	FILE *f;
+
+	f = open_memstream(&buf, &len);
+	redirect_log(f);
+	while (n--) {
+		memset(&m, 0, sizeof(struct mce));
+		m.status = MCI_STATUS_VAL|MCI_STATUS_EN|MCI_STATUS_ADDRV;
+		m.addr = next_addr;
+		m.time = time(NULL);
+		account_page_error(&m, channel, dimm, MEM_SRC_READ);
+		next_addr += 0x1000;
+	}
+	redirect_log(NULL);
+	fclose(f);
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+		printf("%.*s\n", (int)strcspn(line, ","), line);
+	free(buf);
+}
+
+static void usage_in_clusters(void)
+{
+	printf("page memory %zu clusters\n", mem_usage(MEM_PAGE) / 4096);
+}
+
+int main(void)
+{
+	syslog_opt = 0;
+	parse_config_file("pagelimit-test.conf");
+	memdb_config();
+	/* the page counter rounding depends on the build */
+	redirect_log(fopen("/dev/null", "w"));
+	page_setup();
+	redirect_log(NULL);
+
+	printf("-- limit of two clusters\n");
+	mem_set_limit(MEM_PAGE, 2 * 4096);
+	errors(200);
+	usage_in_clusters();
+
+	printf("-- limit raised\n");
+	mem_set_limit(MEM_PAGE, 4 * 4096);
+	errors(200);
+	usage_in_clusters();
+	return 0;
+}
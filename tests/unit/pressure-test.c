@@ -0,0 +1,155 @@
+/* Soft offlines deferred under memory pressure, and their pacing */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "mcelog.h"
+#include "config.h"
+#include "memdb.h"
+#include "msg.h"
+#include "page.h"
+#include "pressure.h"
+
+extern char *proc_dir;
+
+static char dir[] = "/tmp/mcelog-pressure-XXXXXX";
+static unsigned long long migrations;
+
+static void write_file(const char *name, const char *fmt, ...)
+	__attribute__((format(printf,2,3)));
+
+static void write_file(const char *name, const char *fmt, ...)
+{
+	char path[256];
+	va_list ap;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	va_start(ap, fmt);
+	vfprintf(f, fmt, ap);
+	va_end(ap);
+	fclose(f);
+}
+
+/* The system migrated pages more since the last call, with psi stalls */
+static void proc(unsigned long long migrated, double psi)
+{
+	migrations += migrated;
+	write_file("vmstat", "pgmigrate_success %llu\ncompact_stall 0\n", migrations);
+	write_file("pressure/memory",
+		   "some avg10=%.2f avg60=0.00 avg300=0.00 total=0\n"
+		   "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n", psi);
+}
+
+/* Sleep to a tenth into the n-th next second, so that whole seconds pass */
+static void tick(int n)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	t.tv_sec += n;
+	t.tv_nsec = 100000000;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+}
+
+static void error(u64 addr)
+{
+	int channel[2] = { -1, -1 }, dimm[2] = { -1, -1 };
+	struct mce m;
+
+	memset(&m, 0, sizeof(struct mce));
+	m.status = MCI_STATUS_VAL|MCI_STATUS_EN|MCI_STATUS_ADDRV;
+	m.addr = addr;
+	m.time = time(NULL);
+	account_page_error(&m, channel, dimm, MEM_SRC_READ);
+}
+
+static void run(void)
+{
+	static const char *name[] = { "normal", "high", "unknown" };
+
+	printf("offline worker, pressure %s\n", name[pressure_state()]);
+	page_offline_run();
+}
+
+static void stats(void)
+{
+	char *buf, *line, *save;
+	size_t len;
+	FILE *f;
+
+	f = open_memstream(&buf, &len);
+	dump_page_errors(f);
+	fclose(f);
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+		if (!strncmp(line, "Soft offlines", 13) ||
+		    !strncmp(line, "Memory pressure samples", 23))
+			printf("%s\n", line);
+	free(buf);
+}
+
+int main(void)
+{
+	char path[256];
+
+	syslog_opt = 0;
+	if (!mkdtemp(dir)) {
+		perror(dir);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/pressure", dir);
+	mkdir(path, 0700);
+	proc_dir = dir;
+	proc(1000, 0);
+	parse_config_file("pressure-test.conf");
+	memdb_config();
+	/* the page counter rounding depends on the build */
+	redirect_log(fopen("/dev/null", "w"));
+	page_setup();
+	redirect_log(NULL);
+
+	printf("-- quiet system: measured before offlining\n");
+	tick(1);
+	error(0x1000);
+	tick(1);
+	proc(100, 0);
+	run();
+
+	printf("-- migration storm: deferred\n");
+	tick(1);
+	proc(50000, 0);
+	error(0x2000);
+	error(0x3000);
+	run();
+
+	printf("-- overdue under pressure: one page a second\n");
+	tick(2);
+	proc(100000, 0);
+	run();
+	tick(1);
+	proc(50000, 0);
+	run();
+
+	printf("-- memory stalls: deferred until they are gone\n");
+	tick(1);
+	proc(0, 50);
+	error(0x4000);
+	run();
+	tick(1);
+	proc(0, 0);
+	run();
+
+	stats();
+
+	snprintf(path, sizeof(path), "rm -rf %s", dir);
+	return system(path);
+}
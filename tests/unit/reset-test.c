@@ -0,0 +1,45 @@
+/* Resetting a DIMM takes its errors off the socket thresholds */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "mcelog.h"
+#include "config.h"
+#include "memdb.h"
+#include "msg.h"
+
+/* n corrected errors on a DIMM of socket 0 */
+static void errors(int channel, int n)
+{
+	int ch[2] = { channel, -1 }, dimm[2] = { 0, -1 };
+	struct mce m;
+
+	while (n--) {
+		memset(&m, 0, sizeof(struct mce));
+		m.status = MCI_STATUS_VAL|MCI_STATUS_EN;
+		m.time = time(NULL);
+		memory_error(&m, ch, dimm, 0, sizeof(struct mce), MEM_SRC_READ);
+	}
+}
+
+static void reset(int channel)
+{
+	printf("-- reset channel %d: %d\n", channel, memdb_reset(0, channel, 0));
+	dump_memory_errors(stdout, 0);
+}
+
+int main(void)
+{
+	syslog_opt = 0;
+	parse_config_file("reset-test.conf");
+	memdb_config();
+
+	printf("-- socket over threshold\n");
+	errors(0, 6);
+	errors(1, 6);
+	dump_memory_errors(stdout, 0);
+	reset(0);
+	reset(1);
+	reset(2);
+	return 0;
+}
@@ -0,0 +1,51 @@
+/* What the tests need from mcelog.c, and kernel interfaces faked out */
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include "mcelog.h"
+
+enum cputype cputype = CPU_SKYLAKE_XEON;
+int filter_memory_errors;
+int imc_log;
+int max_corr_err_counters = 1000;
+char *processor_flags;
+
+void usage(void)
+{
+}
+
+int __wrap_sysfs_available(const char *name, int flags)
+{
+	(void)name;
+	(void)flags;
+	return 1;
+}
+
+int __wrap_sysfs_write(const char *name, const char *fmt, ...)
+{
+	va_list ap;
+
+	printf("write %s: ", name);
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	putchar('\n');
+	return 0;
+}
+
+/* Tests can point the files of /proc to a directory of their own */
+char *proc_dir;
+
+FILE *__real_fopen(const char *name, const char *mode);
+
+FILE *__wrap_fopen(const char *name, const char *mode)
+{
+	char path[PATH_MAX];
+
+	if (proc_dir && !strncmp(name, "/proc/", 6)) {
+		snprintf(path, sizeof(path), "%s/%s", proc_dir, name + 6);
+		return __real_fopen(path, mode);
+	}
+	return __real_fopen(name, mode);
+}
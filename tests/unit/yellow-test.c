@@ -0,0 +1,95 @@
+/* One report per cache instance for yellow cache errors, and re-arming */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "mcelog.h"
+#include "config.h"
+#include "msg.h"
+#include "trigger.h"
+#include "yellow.h"
+
+enum { DATA = 1, UNIFIED = 3 };
+
+static void would(const char *fmt, ...)
+{
+	va_list ap;
+
+	printf("would ");
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	putchar('\n');
+}
+
+/*
+ * A yellow error on a CPU. The cache topology comes from the sys tree
+ * of the test, where CPUs 0-3 and 4-7 share an L2 and the CPUs above
+ * do not exist. Only the reports are shown.
+ */
+static void yellow(int cpu, int type, int level, time_t t)
+{
+	char *buf, *line, *save;
+	size_t len;
+	FILE *f;
+
+	printf("cpu %d L%d at %ld:\n", cpu, level, (long)t);
+	fflush(stdout);
+	f = open_memstream(&buf, &len);
+	redirect_log(f);
+	run_yellow_trigger(cpu, type, level, type == DATA ? "Data" : "Generic",
+			   level == 1 ? "L1" : "L2", 0, t);
+	redirect_log(NULL);
+	fclose(f);
+	for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+		if (strstr(line, "cache errors") || !strncmp(line, "Cache shared", 12))
+			printf("\t%s\n", line);
+	free(buf);
+}
+
+int main(void)
+{
+	syslog_opt = 0;
+	parse_config_file("yellow-test.conf");
+	yellow_setup();
+
+	printf("-- first report of an instance\n");
+	yellow(100000, UNIFIED, 2, 1000);
+	printf("-- same instance again: suppressed\n");
+	yellow(100000, UNIFIED, 2, 1100);
+	printf("-- other cache and other CPU: reported\n");
+	yellow(100000, DATA, 1, 1100);
+	yellow(100001, UNIFIED, 2, 1100);
+	printf("-- within the re-arm time of the last report: suppressed\n");
+	yellow(100000, UNIFIED, 2, 4100);
+	printf("-- quiet for the re-arm time: reported again\n");
+	yellow(100000, UNIFIED, 2, 7700);
+
+	printf("-- dry run leaves the state alone\n");
+	dry_run = would;
+	yellow(100002, UNIFIED, 2, 8000);
+	yellow(100002, UNIFIED, 2, 8000);
+	dry_run = NULL;
+	yellow(100002, UNIFIED, 2, 8000);
+
+	printf("-- the candidate has its own instances\n");
+	yellow(100003, UNIFIED, 2, 8000);
+	dry_run = would;
+	yellow_use(DB_CANDIDATE);
+	yellow(100003, UNIFIED, 2, 8000);
+	yellow(100003, UNIFIED, 2, 8100);
+	yellow_use(DB_LIVE);
+	dry_run = NULL;
+	yellow(100003, UNIFIED, 2, 8100);
+
+	printf("-- one report per shared L2, not per CPU\n");
+	yellow(1, UNIFIED, 2, 9000);
+	yellow(2, UNIFIED, 2, 9000);
+	yellow(5, UNIFIED, 2, 9000);
+	yellow(4, UNIFIED, 2, 9000);
+	printf("-- the L1 of each CPU is its own instance\n");
+	yellow(5, DATA, 1, 9000);
+	yellow(6, DATA, 1, 9000);
+	return 0;
+}
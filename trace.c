@@ -0,0 +1,177 @@
+/* Record spans of the processing pipeline for a timeline view.
+
+   When enabled, reading, decoding and accounting records, crossed
+   thresholds, page offline writes, triggers and client requests are
+   recorded into a ring buffer of fixed size. The buffer is written as a
+   Chrome trace (JSON), which chrome://tracing and Perfetto can open, on
+   SIGUSR2 or the trace command of the client socket. All records are
+   handled by the main thread and signals only run between event loop
+   iterations, so the buffer has a single writer and needs no locking.
+
+   Names are not copied and must be string constants.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "config.h"
+#include "trace.h"
+
+#define TRACE_FILE "/var/run/mcelog-trace.json"
+
+struct trace_event {
+	const char *name;
+	unsigned long long ts;		/* ns */
+	unsigned long long dur;		/* ns, ~0 for instant events */
+	unsigned long long arg;
+};
+
+int trace_enabled;
+static struct trace_event *ring;
+static unsigned ring_size = 65536;
+static unsigned long long ring_next;	/* events ever recorded */
+static char *trace_file = TRACE_FILE;
+
+unsigned long long trace_clock(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void trace_add(const char *name, unsigned long long ts,
+		      unsigned long long dur, unsigned long long arg)
+{
+	struct trace_event *e = &ring[ring_next++ % ring_size];
+
+	e->name = name;
+	e->ts = ts;
+	e->dur = dur;
+	e->arg = arg;
+}
+
+void trace_end(const char *name, unsigned long long start,
+	       unsigned long long arg)
+{
+	if (!trace_enabled || !start)
+		return;
+	trace_add(name, start, trace_clock() - start, arg);
+}
+
+void trace_mark(const char *name, unsigned long long arg)
+{
+	if (!trace_enabled)
+		return;
+	trace_add(name, trace_clock(), ~0ULL, arg);
+}
+
+void trace_setup(void)
+{
+	char *s;
+
+	if (config_bool("trace", "trace-enabled") != 1)
+		return;
+	config_number("trace", "trace-buffer-size", "%u", &ring_size);
+	if (ring_size == 0)
+		return;
+	s = config_string("trace", "trace-file");
+	if (s)
+		trace_file = s;
+	ring = xalloc_tag(MEM_OTHER, ring_size * sizeof(struct trace_event));
+	trace_enabled = 1;
+}
+
+static void trace_write(FILE *f)
+{
+	unsigned long long i, first;
+	struct trace_event *e;
+	pid_t pid = getpid();
+
+	first = ring_next > ring_size ? ring_next - ring_size : 0;
+	fprintf(f, "{\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+		"\"args\":{\"name\":\"mcelog\"}}", pid);
+	for (i = first; i < ring_next; i++) {
+		e = &ring[i % ring_size];
+		fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"mcelog\",\"pid\":%d,"
+			"\"tid\":%d,\"ts\":%llu.%03llu,", e->name, pid, pid,
+			e->ts / 1000, e->ts % 1000);
+		if (e->dur == ~0ULL)
+			fprintf(f, "\"ph\":\"i\",\"s\":\"p\",");
+		else
+			fprintf(f, "\"ph\":\"X\",\"dur\":%llu.%03llu,",
+				e->dur / 1000, e->dur % 1000);
+		fprintf(f, "\"args\":{\"arg\":%llu}}", e->arg);
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":"
+		"{\"dropped\":%llu}}\n", first);
+}
+
+/*
+ * Write the buffer to the trace file. Returns the number of events
+ * written, or -1.
+ */
+long trace_flush(void)
+{
+	char *tmp;
+	FILE *f;
+	long n;
+	int err;
+
+	if (!trace_enabled)
+		return -1;
+	xasprintf(&tmp, "%s.tmp", trace_file);
+	f = fopen(tmp, "w");
+	if (!f) {
+		SYSERRprintf("Cannot open trace file `%s'", tmp);
+		free(tmp);
+		return -1;
+	}
+	trace_write(f);
+	err = ferror(f);
+	if (fclose(f) != 0 || err || rename(tmp, trace_file) < 0) {
+		SYSERRprintf("Cannot write trace file `%s'", trace_file);
+		unlink(tmp);
+		free(tmp);
+		return -1;
+	}
+	free(tmp);
+	tmp = NULL;
+	n = ring_next < ring_size ? ring_next : ring_size;
+	Lprintf("Wrote %ld trace events to %s\n", n, trace_file);
+	return n;
+}
+
+/* trace command of the client socket */
+void dump_trace(FILE *f)
+{
+	long n;
+
+	if (!trace_enabled) {
+		fprintf(f, "Tracing is not enabled\n");
+		return;
+	}
+	n = trace_flush();
+	if (n < 0)
+		fprintf(f, "Cannot write trace file %s\n", trace_file);
+	else
+		fprintf(f, "%ld trace events written to %s, %llu dropped\n", n,
+			trace_file, ring_next - n);
+}
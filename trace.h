@@ -0,0 +1,18 @@
+#include <stdio.h>
+
+extern int trace_enabled;
+
+unsigned long long trace_clock(void);
+
+/* Start time of a span, 0 when tracing is off */
+static inline unsigned long long trace_begin(void)
+{
+	return trace_enabled ? trace_clock() : 0;
+}
+
+void trace_end(const char *name, unsigned long long start,
+	       unsigned long long arg);
+void trace_mark(const char *name, unsigned long long arg);
+void trace_setup(void);
+long trace_flush(void);
+void dump_trace(FILE *f);
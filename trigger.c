@@ -22,18 +22,28 @@
 #include <signal.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdarg.h>
+#include <syslog.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include "trigger.h"
 #include "eventloop.h"
 #include "list.h"
 #include "mcelog.h"
 #include "memutil.h"
 #include "config.h"
+#include "trace.h"
 
 struct child {
 	struct list_head nd;
 	pid_t child;
 	const char *name;
+	unsigned long long start;	/* trace span */
 };
 
 static LIST_HEAD(childlist);
@@ -41,27 +51,242 @@ static int num_children;
 static int children_max = 4;
 static char *trigger_dir;
 
+static char *path_env;
+
+dry_run_fn dry_run;
+
 static void finish_child(pid_t child, int status);
 
+static char *trigger_path(void)
+{
+	if (!path_env)
+		xasprintf(&path_env, "PATH=%s",
+			  getenv("PATH") ?: "/sbin:/usr/sbin:/bin:/usr/bin");
+	return path_env;
+}
+
+/* Start a template with the variables every trigger gets */
+void trigger_template_init(struct trigger_template *t)
+{
+	t->n = 0;
+	t->env[t->n++] = trigger_path();
+}
+
+void trigger_template_add(struct trigger_template *t, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (t->n >= MAX_TRIGGER_ENV) {
+		Eprintf("Too many trigger environment variables\n");
+		return;
+	}
+	va_start(ap, fmt);
+	if (vasprintf(&t->env[t->n], fmt, ap) < 0)
+		Enomem();
+	va_end(ap);
+	t->n++;
+}
+
+/* A template that was never set up still passes PATH */
+void trigger_env_init(struct trigger_env *e, const struct trigger_template *t)
+{
+	e->len = 0;
+	if (t->n == 0) {
+		e->env[0] = trigger_path();
+		e->n = 1;
+		return;
+	}
+	memcpy(e->env, t->env, t->n * sizeof(char *));
+	e->n = t->n;
+}
+
+void trigger_env_add(struct trigger_env *e, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if (e->n >= MAX_TRIGGER_ENV) {
+		Eprintf("Too many trigger environment variables\n");
+		return;
+	}
+	va_start(ap, fmt);
+	n = vsnprintf(e->buf + e->len, sizeof(e->buf) - e->len, fmt, ap);
+	va_end(ap);
+	if (n < 0 || (unsigned)n >= sizeof(e->buf) - e->len) {
+		Eprintf("Trigger environment too large\n");
+		e->buf[e->len] = 0;
+		return;
+	}
+	e->env[e->n++] = e->buf + e->len;
+	e->len += n + 1;
+}
+
+/* Add a variable rendered by the caller, valid until run_trigger returns */
+void trigger_env_put(struct trigger_env *e, char *var)
+{
+	if (e->n >= MAX_TRIGGER_ENV) {
+		Eprintf("Too many trigger environment variables\n");
+		return;
+	}
+	e->env[e->n++] = var;
+}
+
+char **trigger_env(struct trigger_env *e)
+{
+	e->env[e->n] = NULL;
+	return e->env;
+}
+
 pid_t mcelog_fork(const char *name)
 {
 	pid_t child;
 	struct child *c;
+	unsigned long long start = trace_begin();
 
 	child = fork();
 	if (child <= 0)
 		return child;
+	trace_end("trigger fork", start, child);
 
 	num_children++;
 	c = xalloc(sizeof(struct child));
 	c->name = name;
 	c->child = child;
+	c->start = start;
 	list_add_tail(&c->nd, &childlist);
 	return child;
 }
 
 // note: trigger must be allocated, e.g. from config
-void run_trigger(char *trigger, char *argv[], char **env, bool sync, const char* reporter)
+/*
+ * Built-in actions run in the daemon instead of a script. A trigger
+ * value is a comma separated list of actions and trigger programs.
+ *
+ * @syslog		log MESSAGE and LOCATION to syslog
+ * @file:path		append MESSAGE and LOCATION to path
+ * @socket:path	send the environment as one datagram to a unix socket
+ * @touch:path		create path or update its time stamp
+ */
+enum builtin { B_SYSLOG, B_FILE, B_SOCKET, B_TOUCH };
+
+static const struct {
+	const char *name;
+	int arg;
+} builtins[] = {
+	[B_SYSLOG] = { "@syslog", 0 },
+	[B_FILE] = { "@file:", 1 },
+	[B_SOCKET] = { "@socket:", 1 },
+	[B_TOUCH] = { "@touch:", 1 },
+};
+
+/* Returns the action, or -1 if s is not a valid built-in action. */
+static int builtin_parse(const char *s, const char **arg)
+{
+	unsigned i;
+	size_t n;
+
+	for (i = 0; i < sizeof(builtins) / sizeof(*builtins); i++) {
+		n = strlen(builtins[i].name);
+		if (strncmp(s, builtins[i].name, n))
+			continue;
+		*arg = s + n;
+		if (builtins[i].arg ? **arg == 0 : **arg != 0)
+			return -1;
+		return i;
+	}
+	return -1;
+}
+
+static char *env_value(char **env, const char *name)
+{
+	size_t n = strlen(name);
+
+	for (; *env; env++)
+		if (!strncmp(*env, name, n) && (*env)[n] == '=')
+			return *env + n + 1;
+	return NULL;
+}
+
+static void builtin_file(const char *path, char **env, const char *reporter)
+{
+	char *msg = env_value(env, "MESSAGE"), *loc = env_value(env, "LOCATION");
+	FILE *f = fopen(path, "a");
+
+	if (!f) {
+		SYSERRprintf("Cannot open trigger file `%s'", path);
+		return;
+	}
+	fprintf(f, "%lu %s: %s\n", (unsigned long)time(NULL), reporter,
+		msg ?: "");
+	if (loc)
+		fprintf(f, "%lu %s: Location: %s\n", (unsigned long)time(NULL),
+			reporter, loc);
+	if (fclose(f))
+		SYSERRprintf("Cannot write trigger file `%s'", path);
+}
+
+/* Best effort, the receiver must keep up */
+static void builtin_socket(const char *path, char **env, const char *reporter)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	char buf[TRIGGER_ENV_BUF * 2];
+	int fd, n, len;
+
+	len = snprintf(buf, sizeof(buf), "REPORTER=%s\n", reporter);
+	for (; *env && len < (int)sizeof(buf); env++) {
+		n = snprintf(buf + len, sizeof(buf) - len, "%s\n", *env);
+		len += n;
+	}
+	if (len >= (int)sizeof(buf))
+		len = sizeof(buf) - 1;
+
+	fd = socket(AF_UNIX, SOCK_DGRAM|SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		SYSERRprintf("trigger socket");
+		return;
+	}
+	strncpy(sun.sun_path, path, sizeof(sun.sun_path) - 1);
+	if (sendto(fd, buf, len, MSG_DONTWAIT, (struct sockaddr *)&sun,
+		   sizeof(sun)) < 0)
+		SYSERRprintf("Cannot send to trigger socket `%s'", path);
+	close(fd);
+}
+
+static void builtin_touch(const char *path)
+{
+	int fd = open(path, O_WRONLY|O_CREAT|O_CLOEXEC, 0644);
+
+	if (fd < 0 || futimens(fd, NULL) < 0)
+		SYSERRprintf("Cannot touch trigger file `%s'", path);
+	if (fd >= 0)
+		close(fd);
+}
+
+static void run_builtin(int b, const char *arg, char **env, const char *reporter)
+{
+	char *s;
+
+	switch (b) {
+	case B_SYSLOG:
+		if ((s = env_value(env, "MESSAGE")) != NULL)
+			syslog(LOG_DAEMON|LOG_ERR, "%s", s);
+		if ((s = env_value(env, "LOCATION")) != NULL)
+			syslog(LOG_DAEMON|LOG_ERR, "Location: %s", s);
+		break;
+	case B_FILE:
+		builtin_file(arg, env, reporter);
+		break;
+	case B_SOCKET:
+		builtin_socket(arg, env, reporter);
+		break;
+	case B_TOUCH:
+		builtin_touch(arg);
+		break;
+	}
+}
+
+static void exec_trigger(char *trigger, char *argv[], char **env,
+			 const char* reporter)
 {
 	pid_t child;
 
@@ -93,6 +318,39 @@ void run_trigger(char *trigger, char *argv[], char **env, bool sync, const char*
 	}
 }
 
+void run_trigger(char *trigger, char *argv[], char **env, bool sync, const char* reporter)
+{
+	char *list, *s, *save;
+	const char *arg;
+	int b;
+
+	if (dry_run) {
+		dry_run("run %s trigger %s", reporter, trigger);
+		return;
+	}
+	if (trigger[0] != '@' && !strchr(trigger, ',')) {
+		exec_trigger(trigger, argv, env, reporter);
+		return;
+	}
+
+	list = xstrdup(trigger);
+	for (s = strtok_r(list, ",", &save); s; s = strtok_r(NULL, ",", &save)) {
+		if (s[0] != '@') {
+			if (argv)
+				argv[0] = s;
+			exec_trigger(s, argv, env, reporter);
+			continue;
+		}
+		b = builtin_parse(s, &arg);
+		if (b >= 0)
+			run_builtin(b, arg, env, reporter);
+	}
+	if (argv)
+		argv[0] = trigger;
+	free(list);
+	list = NULL;
+}
+
 /* Clean up child on SIGCHLD */
 static void finish_child(pid_t child, int status)
 {
@@ -107,6 +365,7 @@ static void finish_child(pid_t child, int status)
 				Eprintf("Trigger `%s' died with signal %s\n",
 					c->name, strsignal(WTERMSIG(status)));
 			}
+			trace_end("trigger", c->start, status);
 			list_del(&c->nd);
 			free(c);
 			c = NULL;
@@ -164,7 +423,7 @@ void trigger_wait(void)
 		finish_child(pid, status);
 }
 
-int trigger_check(char *s)
+static int check_program(char *s)
 {
 	char *name;
 	int rc;
@@ -183,3 +442,27 @@ int trigger_check(char *s)
 
 	return rc;
 }
+
+int trigger_check(char *s)
+{
+	char *list, *p, *save;
+	const char *arg;
+	int rc = 0;
+
+	if (s[0] != '@' && !strchr(s, ','))
+		return check_program(s);
+
+	list = xstrdup(s);
+	for (p = strtok_r(list, ",", &save); p && rc == 0;
+	     p = strtok_r(NULL, ",", &save)) {
+		if (p[0] != '@')
+			rc = check_program(p);
+		else if (builtin_parse(p, &arg) < 0) {
+			errno = EINVAL;
+			rc = -1;
+		}
+	}
+	free(list);
+	list = NULL;
+	return rc;
+}
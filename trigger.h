@@ -2,6 +2,41 @@
 #define __TRIGGER_H__
 
 #include <stdbool.h>
+
+enum {
+	MAX_TRIGGER_ENV = 32,
+	TRIGGER_ENV_BUF = 4096,
+};
+
+/* Environment of a trigger class that does not change, rendered at setup */
+struct trigger_template {
+	int n;
+	char *env[MAX_TRIGGER_ENV];
+};
+
+/* Environment of one trigger run, formatted into a single buffer */
+struct trigger_env {
+	int n;
+	unsigned len;
+	char *env[MAX_TRIGGER_ENV + 1];
+	char buf[TRIGGER_ENV_BUF];
+};
+
+void trigger_template_init(struct trigger_template *t);
+void trigger_template_add(struct trigger_template *t, const char *fmt, ...)
+	__attribute__((format(printf,2,3)));
+void trigger_env_init(struct trigger_env *e, const struct trigger_template *t);
+void trigger_env_add(struct trigger_env *e, const char *fmt, ...)
+	__attribute__((format(printf,2,3)));
+void trigger_env_put(struct trigger_env *e, char *var);
+char **trigger_env(struct trigger_env *e);
+/*
+ * While set, triggers, threshold reports and page offlining are passed
+ * here instead of being done, e.g. for synthetic records.
+ */
+typedef void (*dry_run_fn)(const char *fmt, ...) __attribute__((format(printf,1,2)));
+extern dry_run_fn dry_run;
+
 void run_trigger(char *trigger, char *argv[], char **env, bool sync, const char* reporter);
 void trigger_setup(void);
 void trigger_wait(void);
@@ -16,7 +16,6 @@
    on your Linux system. */
 #define _GNU_SOURCE 1
 #include <stdio.h>
-#include <assert.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -27,10 +26,7 @@
 #include "unknown.h"
 
 static char *unknown_trigger;
-
-enum {
-	MAX_ENV = 20,
-};
+static struct trigger_template unknown_env;
 
 void unknown_setup(void)
 {
@@ -40,13 +36,12 @@ void unknown_setup(void)
 				unknown_trigger);
 		exit(1);
 	}
+	trigger_template_init(&unknown_env);
 }
 
 void run_unknown_trigger(int socket, int cpu, struct mce *log)
 {
-	int ei = 0;
-	char *env[MAX_ENV];
-	int i;
+	struct trigger_env env;
 	char *msg;
 	char *location;
 
@@ -58,27 +53,22 @@ void run_unknown_trigger(int socket, int cpu, struct mce *log)
 	else
 		xasprintf(&location, "CPU %d", cpu);
 	xasprintf(&msg, "%s received unknown error", location);
-	xasprintf(&env[ei++], "LOCATION=%s", location);
+	trigger_env_init(&env, &unknown_env);
+	trigger_env_add(&env, "LOCATION=%s", location);
 	free(location);
 	location = NULL;
 
 	if (socket >= 0)
-		xasprintf(&env[ei++], "SOCKETID=%d", socket);
-	xasprintf(&env[ei++], "MESSAGE=%s", msg);
-	xasprintf(&env[ei++], "CPU=%d", cpu);
-	xasprintf(&env[ei++], "STATUS=%llx", log->status);
-	xasprintf(&env[ei++], "MISC=%llx", log->misc);
-	xasprintf(&env[ei++], "ADDR=%llx", log->addr);
-	xasprintf(&env[ei++], "MCGSTATUS=%llx", log->mcgstatus);
-	xasprintf(&env[ei++], "MCGCAP=%llx", log->mcgcap);
-	env[ei] = NULL;
-	assert(ei < MAX_ENV);
+		trigger_env_add(&env, "SOCKETID=%d", socket);
+	trigger_env_add(&env, "MESSAGE=%s", msg);
+	trigger_env_add(&env, "CPU=%d", cpu);
+	trigger_env_add(&env, "STATUS=%llx", log->status);
+	trigger_env_add(&env, "MISC=%llx", log->misc);
+	trigger_env_add(&env, "ADDR=%llx", log->addr);
+	trigger_env_add(&env, "MCGSTATUS=%llx", log->mcgstatus);
+	trigger_env_add(&env, "MCGCAP=%llx", log->mcgcap);
 
-	run_trigger(unknown_trigger, NULL, env, false, "unknown");
-	for (i = 0; i < ei; i++) {
-		free(env[i]);
-		env[i] = NULL;
-	}
+	run_trigger(unknown_trigger, NULL, trigger_env(&env), false, "unknown");
 	free(msg);
 	msg = NULL;
 }
@@ -0,0 +1 @@
+char version[] = "";
@@ -0,0 +1,140 @@
+/* Hierarchical timing wheel for expiring idle entries.
+
+   Every level has 64 slots, each slot of a level covers a full turn of
+   the level below. An entry is put into the slot of its expiry time and
+   cascades down to finer levels while that time comes closer, so each
+   tick only touches the entries that are due. Entries are queued
+   lazily: when their activity moves the expiry time the owner just
+   returns the new time when the old slot comes up.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "mcelog.h"
+#include "eventloop.h"
+#include "wheel.h"
+
+#define WHEEL_RANGE (1UL << (WHEEL_BITS * WHEEL_LEVELS))
+
+static struct wheel *wheels[4];
+static int nwheels;
+static int wheel_fd = -1;
+
+void wheel_add(struct wheel *w, struct wheel_node *n, time_t t)
+{
+	unsigned long e, delta;
+	int level;
+
+	if (w->cur == 0)
+		w->cur = time(NULL) / WHEEL_TICK;
+	e = (t + WHEEL_TICK - 1) / WHEEL_TICK;
+	if (t <= 0 || e <= w->cur)
+		e = w->cur + 1;
+	delta = e - w->cur;
+	/* far out entries are checked again at the end of the range */
+	if (delta >= WHEEL_RANGE) {
+		delta = WHEEL_RANGE - 1;
+		e = w->cur + delta;
+	}
+	for (level = 0; level < WHEEL_LEVELS - 1; level++)
+		if (delta < 1UL << (WHEEL_BITS * (level + 1)))
+			break;
+	e = (e >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1);
+	n->next = w->slot[level][e];
+	w->slot[level][e] = n;
+	w->queued++;
+}
+
+static void wheel_slot(struct wheel *w, int level, unsigned idx, time_t now)
+{
+	struct wheel_node *n, *next;
+	time_t t;
+
+	n = w->slot[level][idx];
+	w->slot[level][idx] = NULL;
+	for (; n; n = next) {
+		next = n->next;
+		w->queued--;
+		t = w->check(n, now);
+		if (t)
+			wheel_add(w, n, t);
+	}
+}
+
+/* Process all ticks up to now */
+void wheel_run(struct wheel *w, time_t now)
+{
+	unsigned long target = now / WHEEL_TICK;
+	int level;
+
+	if (w->cur == 0) {
+		w->cur = target;
+		return;
+	}
+	while (w->cur < target) {
+		w->cur++;
+		/* move the next turn of each coarser level down */
+		for (level = 1; level < WHEEL_LEVELS; level++) {
+			if (w->cur & ((1UL << (WHEEL_BITS * level)) - 1))
+				break;
+			wheel_slot(w, level, (w->cur >> (WHEEL_BITS * level)) &
+				   (WHEEL_SLOTS - 1), w->cur * WHEEL_TICK);
+		}
+		wheel_slot(w, 0, w->cur & (WHEEL_SLOTS - 1), w->cur * WHEEL_TICK);
+	}
+}
+
+static void wheel_tick(struct pollfd *pfd, void *data)
+{
+	uint64_t expirations;
+	time_t now = time(NULL);
+	int i;
+
+	(void)data;
+	if (read(pfd->fd, &expirations, sizeof(expirations)) < 0)
+		return;
+	for (i = 0; i < nwheels; i++)
+		wheel_run(wheels[i], now);
+}
+
+/* Run the wheel from the event loop, once per tick */
+void wheel_register(struct wheel *w)
+{
+	struct itimerspec its = {
+		.it_interval = { .tv_sec = WHEEL_TICK },
+		.it_value = { .tv_sec = WHEEL_TICK },
+	};
+
+	if (nwheels == (int)NELE(wheels))
+		return;
+	if (wheel_fd < 0) {
+		wheel_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+		if (wheel_fd < 0) {
+			SYSERRprintf("Cannot create timer for idle expiry");
+			return;
+		}
+		if (timerfd_settime(wheel_fd, 0, &its, NULL) < 0 ||
+		    register_pollcb(wheel_fd, POLLIN, wheel_tick, NULL) < 0) {
+			SYSERRprintf("Cannot set up timer for idle expiry");
+			close(wheel_fd);
+			wheel_fd = -1;
+			return;
+		}
+	}
+	wheels[nwheels++] = w;
+}
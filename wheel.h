@@ -0,0 +1,28 @@
+#include <time.h>
+
+enum {
+	WHEEL_TICK = 60,		/* seconds per slot */
+	WHEEL_BITS = 6,
+	WHEEL_SLOTS = 1 << WHEEL_BITS,
+	WHEEL_LEVELS = 4,
+};
+
+struct wheel_node {
+	struct wheel_node *next;
+};
+
+struct wheel {
+	/*
+	 * Called when the slot of n comes up. Returns the time when n
+	 * expires now, to queue it again, or 0 when the owner reclaimed it
+	 * or does not want it to expire.
+	 */
+	time_t (*check)(struct wheel_node *n, time_t now);
+	unsigned long cur;		/* last tick processed */
+	unsigned long queued;
+	struct wheel_node *slot[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+void wheel_add(struct wheel *w, struct wheel_node *n, time_t expires);
+void wheel_run(struct wheel *w, time_t now);
+void wheel_register(struct wheel *w);
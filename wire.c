@@ -0,0 +1,291 @@
+/* Binary machine check record format.
+
+   A compact, versioned alternative to the --raw ASCII output that can
+   be converted back without re-parsing text. See wire.h for the layout.
+
+   mcelog is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public
+   License as published by the Free Software Foundation; version
+   2.
+
+   mcelog is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should find a copy of v2 of the GNU General Public License somewhere
+   on your Linux system; if not, write to the Free Software Foundation,
+   Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
+#define _GNU_SOURCE 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mcelog.h"
+#include "memutil.h"
+#include "bitfield.h"
+#include "msg.h"
+#include "wire.h"
+
+int wire_output;
+static int header_written;
+static FILE *wire_fh;
+static char *wire_fn;
+
+/* CRC32 (IEEE). Start with ~0 and invert the final value. */
+static u32 crc32_update(u32 crc, const void *buf, size_t len)
+{
+	const u8 *p = buf;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return crc;
+}
+
+static int put_varint(u8 *p, u32 v)
+{
+	int n = 0;
+
+	while (v >= 0x80) {
+		p[n++] = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	p[n++] = v;
+	return n;
+}
+
+/* Returns bytes consumed, or 0 on a truncated or overlong varint */
+static int get_varint(const u8 *p, size_t len, u32 *v)
+{
+	int n = 0, shift = 0;
+
+	*v = 0;
+	while ((size_t)n < len && n < 5) {
+		*v |= (u32)(p[n] & 0x7f) << shift;
+		if (!(p[n++] & 0x80))
+			return n;
+		shift += 7;
+	}
+	return 0;
+}
+
+static enum wire_summary wire_summary(struct mce *m)
+{
+	u32 mca = m->status & 0xffff;
+
+	if (m->bank == MCE_THERMAL_BANK)
+		return WS_THERMAL;
+	if (test_prefix(11, mca))
+		return WS_BUS;
+	if (test_prefix(8, mca))
+		return WS_CACHE;
+	if (test_prefix(7, mca))
+		return WS_MEMORY;
+	if (test_prefix(4, mca))
+		return WS_TLB;
+	if (mca && (mca & ~0x1000) < 0x10)
+		return WS_INTERNAL;
+	return WS_OTHER;
+}
+
+/* The record is written straight from the caller's buffer */
+static unsigned stream_flags(void)
+{
+	return wire_output > 1 ? WIRE_CRC : 0;
+}
+
+/*
+ * Write the records to fn instead of stdout. A stream already in the
+ * file is continued, so it must have been written with the same flags.
+ */
+int wire_open(char *fn)
+{
+	struct wire_header h;
+	FILE *f;
+
+	f = fopen(fn, "a+");
+	if (!f) {
+		SYSERRprintf("Cannot open wire file `%s'", fn);
+		return -1;
+	}
+	header_written = 0;
+	if (fread(&h, sizeof(h), 1, f) == 1) {
+		if (memcmp(h.magic, WIRE_MAGIC, 4) || h.version != WIRE_VERSION ||
+		    h.flags != stream_flags()) {
+			Eprintf("`%s' holds a different wire stream\n", fn);
+			fclose(f);
+			return -1;
+		}
+		header_written = 1;
+	}
+	if (wire_fh)
+		fclose(wire_fh);
+	wire_fh = f;
+	if (fn != wire_fn) {
+		free(wire_fn);
+		wire_fn = xstrdup(fn);
+	}
+	return 0;
+}
+
+/* After log rotation: start a new stream in a new file */
+void wire_reopen(void)
+{
+	if (wire_fn)
+		wire_open(wire_fn);
+}
+
+static void wire_put(const void *buf, size_t len)
+{
+	fwrite(buf, 1, len, wire_fh ? wire_fh : stdout);
+}
+
+void wire_write(struct mce *m, unsigned recordlen, unsigned flags)
+{
+	struct wire_record wr;
+	u8 len[5];
+	int n;
+	u32 crc;
+
+	if (!header_written) {
+		struct wire_header h = {
+			.magic = WIRE_MAGIC,
+			.version = WIRE_VERSION,
+			.flags = stream_flags(),
+		};
+		wire_put(&h, sizeof(h));
+		header_written = 1;
+	}
+
+	if (recordlen > sizeof(struct mce))
+		recordlen = sizeof(struct mce);
+	wr.recordlen = recordlen;
+	wr.summary = wire_summary(m);
+	wr.flags = flags;
+	if (m->status & MCI_STATUS_UC)
+		wr.flags |= WR_UC;
+
+	n = put_varint(len, sizeof(wr) + recordlen + (wire_output > 1 ? 4 : 0));
+	wire_put(len, n);
+	wire_put(&wr, sizeof(wr));
+	wire_put(m, recordlen);
+	if (wire_output > 1) {
+		crc = crc32_update(~0U, &wr, sizeof(wr));
+		crc = ~crc32_update(crc, m, recordlen);
+		wire_put(&crc, sizeof(crc));
+	}
+	/* the daemon writes rarely, readers should see whole records */
+	if (wire_fh)
+		fflush(wire_fh);
+}
+
+/* Map or read the whole input. */
+static u8 *wire_load(FILE *f, size_t *len, int *mapped)
+{
+	struct stat st;
+	u8 *buf = NULL;
+	size_t n, size = 0;
+
+	*mapped = 0;
+	if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+		if (buf != MAP_FAILED) {
+			*mapped = 1;
+			*len = st.st_size;
+			return buf;
+		}
+		buf = NULL;
+	}
+	*len = 0;
+	do {
+		if (*len == size) {
+			size = size ? size * 2 : 65536;
+			buf = xrealloc(buf, size);
+		}
+		n = fread(buf + *len, 1, size - *len, f);
+		*len += n;
+	} while (n > 0);
+	return buf;
+}
+
+/*
+ * Call fn for every record in a wire stream. Records are parsed in place;
+ * only the struct mce is copied, so that short records from older kernels
+ * read as zero in the missing fields. Returns the number of bad records,
+ * or -1 if the stream is not in wire format.
+ */
+int wire_read(FILE *f, void (*fn)(struct mce *m, unsigned recordlen,
+				  struct wire_record *wr))
+{
+	struct wire_header h;
+	struct wire_record wr;
+	struct mce m;
+	size_t len, off;
+	u8 *buf;
+	int mapped, n, bad = 0;
+	unsigned nr = 0;
+	u32 blen, crc, want;
+	int crclen;
+
+	buf = wire_load(f, &len, &mapped);
+	if (len < sizeof(h) || memcmp(buf, WIRE_MAGIC, 4)) {
+		Eprintf("Input is not in mcelog wire format\n");
+		bad = -1;
+		goto out;
+	}
+	memcpy(&h, buf, sizeof(h));
+	if (h.version != WIRE_VERSION) {
+		Eprintf("Unsupported wire format version %u\n", h.version);
+		bad = -1;
+		goto out;
+	}
+	crclen = h.flags & WIRE_CRC ? 4 : 0;
+
+	for (off = sizeof(h); off < len; off += blen) {
+		nr++;
+		n = get_varint(buf + off, len - off, &blen);
+		if (n == 0 || blen > len - off - n) {
+			Eprintf("wire record %u truncated\n", nr);
+			bad++;
+			break;
+		}
+		off += n;
+		if (blen < sizeof(wr) + crclen) {
+			Eprintf("wire record %u too short\n", nr);
+			bad++;
+			continue;
+		}
+		memcpy(&wr, buf + off, sizeof(wr));
+		if (wr.recordlen > blen - sizeof(wr) - crclen) {
+			Eprintf("wire record %u has bad length\n", nr);
+			bad++;
+			continue;
+		}
+		if (crclen) {
+			memcpy(&want, buf + off + blen - crclen, sizeof(want));
+			crc = ~crc32_update(~0U, buf + off, blen - crclen);
+			if (crc != want) {
+				Eprintf("wire record %u checksum mismatch\n", nr);
+				bad++;
+				continue;
+			}
+		}
+		memset(&m, 0, sizeof(struct mce));
+		memcpy(&m, buf + off + sizeof(wr),
+		       wr.recordlen < sizeof(struct mce) ? wr.recordlen :
+		       sizeof(struct mce));
+		fn(&m, wr.recordlen, &wr);
+	}
+out:
+	if (mapped)
+		munmap(buf, len);
+	else
+		free(buf);
+	return bad;
+}
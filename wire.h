@@ -0,0 +1,59 @@
+#ifndef WIRE_H
+#define WIRE_H 1
+
+/*
+ * Binary machine check record format.
+ *
+ * A stream starts with a struct wire_header. Each record is a LEB128
+ * varint with the length of the body, followed by the body: a struct
+ * wire_record, recordlen bytes of struct mce as read from the kernel
+ * and, when the stream has WIRE_CRC set, a CRC32 of the preceding body.
+ * All fields are in host byte order, like the kernel records.
+ */
+
+#define WIRE_MAGIC	"MCEW"
+#define WIRE_VERSION	1
+
+enum wire_stream_flags {
+	WIRE_CRC = (1 << 0),
+};
+
+struct wire_header {
+	char magic[4];
+	u8 version;
+	u8 flags;
+	u16 reserved;
+} __attribute__((packed));
+
+enum wire_summary {
+	WS_OTHER,
+	WS_INTERNAL,
+	WS_TLB,
+	WS_MEMORY,
+	WS_CACHE,
+	WS_BUS,
+	WS_THERMAL,
+};
+
+enum wire_record_flags {
+	WR_UC = (1 << 0),		/* uncorrected error */
+	WR_ASCII = (1 << 1),		/* converted from ASCII input */
+	WR_SCRUB_UC = (1 << 2),		/* uncorrected patrol scrub, page offline path */
+};
+
+struct wire_record {
+	u16 recordlen;
+	u8 summary;
+	u8 flags;
+} __attribute__((packed));
+
+/* 0: text output, 1: wire output, 2: wire output with CRC */
+extern int wire_output;
+
+int wire_open(char *fn);
+void wire_reopen(void);
+void wire_write(struct mce *m, unsigned recordlen, unsigned flags);
+int wire_read(FILE *f, void (*fn)(struct mce *m, unsigned recordlen,
+				  struct wire_record *wr));
+
+#endif
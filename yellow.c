@@ -17,10 +17,10 @@
    Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA */
 #define _GNU_SOURCE 1
 #include <stdio.h>
-#include <assert.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <time.h>
 #include "memutil.h"
 #include "mcelog.h"
 #include "config.h"
@@ -33,11 +33,32 @@
 
 static char *yellow_trigger;
 static int yellow_log = 1;
+static unsigned yellow_rearm = 24*60*60;
+static struct trigger_template yellow_env;
 
-enum {
-	MAX_ENV = 10,
+/*
+ * A yellow indication is reported by every CPU sharing the affected cache.
+ * Track the state per physical cache instance, identified by level, type
+ * and the lowest CPU in its shared_cpu_map, so that only the first report
+ * of an instance generates an event. The instance re-arms after
+ * cache-threshold-rearm seconds without a new event.
+ */
+struct yellow_cache {
+	struct yellow_cache *next;
+	int level;
+	int type;
+	unsigned first_cpu;
+	time_t tstamp;		/* last yellow report */
+	unsigned events;
+	unsigned suppressed;
+	char *affected;		/* precomputed AFFECTED_CPUS= */
 };
 
+/* the live instances and the separate ones of the candidate policy */
+static struct yellow_cache *live_caches, *candidate_caches;
+static struct yellow_cache **yellow_caches = &live_caches;
+static enum mem_subsys yellow_mem = MEM_CACHE;
+
 static char *cpulist(char *prefix, unsigned *cpumask, unsigned cpumasklen)
 {
 	unsigned i, k;
@@ -58,15 +79,94 @@ static char *cpulist(char *prefix, unsigned *cpumask, unsigned cpumasklen)
 	return buf;
 }
 
-void run_yellow_trigger(int cpu, int tnum, int lnum, char *ts, char *ls, int socket)
+static unsigned first_cpu(unsigned *cpumask, unsigned cpumasklen, unsigned cpu)
+{
+	unsigned i;
+
+	for (i = 0; i < cpumasklen * 8; i++)
+		if (test_bit(i, cpumask))
+			return i;
+	return cpu;
+}
+
+static struct yellow_cache *yellow_cache_get(int cpu, int tnum, int lnum)
 {
-	int ei = 0;
-	char *env[MAX_ENV];
+	struct yellow_cache *yc;
 	unsigned *cpumask;
 	int cpumasklen;
-	int i;
+	unsigned first = cpu;
+	char *affected;
+
+	if (cache_to_cpus(cpu, lnum, tnum, &cpumasklen, &cpumask) >= 0) {
+		first = first_cpu(cpumask, cpumasklen, cpu);
+		affected = NULL;
+	} else {
+		cpumask = NULL;
+		affected = "AFFECTED_CPUS=unknown";
+	}
+
+	for (yc = *yellow_caches; yc; yc = yc->next) {
+		if (yc->level == lnum && yc->type == tnum &&
+		    yc->first_cpu == first)
+			return yc;
+	}
+
+	yc = xalloc_tag(yellow_mem, sizeof(struct yellow_cache));
+	yc->level = lnum;
+	yc->type = tnum;
+	yc->first_cpu = first;
+	if (cpumask) {
+		yc->affected = cpulist("AFFECTED_CPUS=", cpumask, cpumasklen);
+		mem_track(yellow_mem, yc->affected);
+	} else
+		yc->affected = xstrdup_tag(yellow_mem, affected);
+	yc->next = *yellow_caches;
+	*yellow_caches = yc;
+	return yc;
+}
+
+/* Over the memory limit: forget instances that re-armed already */
+static void yellow_evict(size_t excess)
+{
+	struct yellow_cache *yc, **prev = &live_caches;
+	time_t now = time(NULL);
+
+	(void)excess;
+	while ((yc = *prev) != NULL) {
+		if (now - yc->tstamp < (time_t)yellow_rearm) {
+			prev = &yc->next;
+			continue;
+		}
+		*prev = yc->next;
+		xfree_tag(MEM_CACHE, yc->affected);
+		xfree_tag(MEM_CACHE, yc);
+	}
+}
+
+void run_yellow_trigger(int cpu, int tnum, int lnum, char *ts, char *ls, int socket,
+			time_t t)
+{
+	struct trigger_env env;
 	char *msg;
 	char *location;
+	struct yellow_cache *yc;
+	/* a dry run must not change what the live records see */
+	int update = !dry_run || yellow_caches == &candidate_caches;
+
+	if (!t)
+		t = time(NULL);
+	yc = yellow_cache_get(cpu, tnum, lnum);
+	if (yc->events > 0 && t - yc->tstamp < (time_t)yellow_rearm) {
+		if (update) {
+			yc->tstamp = t;
+			yc->suppressed++;
+		}
+		return;
+	}
+	if (update) {
+		yc->tstamp = t;
+		yc->events++;
+	}
 
 	if (socket >= 0) 
 		xasprintf(&location, "CPU %d on socket %d", cpu, socket);
@@ -76,36 +176,50 @@ void run_yellow_trigger(int cpu, int tnum, int lnum, char *ts, char *ls, int soc
 		location, ls, ts);
 	free(location);
 	location = NULL;
+	if (dry_run) {
+		dry_run("report %s", msg);
+		goto out;
+	}
 	if (yellow_log) {
 		Lprintf("%s\n", msg);
+		Lprintf("Cache shared by %s\n",
+			yc->affected + sizeof("AFFECTED_CPUS=") - 1);
 		Lprintf("System operating correctly, but might lead to uncorrected cache errors soon\n");
 	}
 	if (!yellow_trigger)
 		goto out;
 
+	trigger_env_init(&env, &yellow_env);
 	if (socket >= 0)
-		xasprintf(&env[ei++], "SOCKETID=%d", socket);
-	xasprintf(&env[ei++], "MESSAGE=%s", msg);
-	xasprintf(&env[ei++], "CPU=%d", cpu);
-	xasprintf(&env[ei++], "LEVEL=%d", lnum);
-	xasprintf(&env[ei++], "TYPE=%s", ts);
-	if (cache_to_cpus(cpu, lnum, tnum, &cpumasklen, &cpumask) >= 0)
-		env[ei++] = cpulist("AFFECTED_CPUS=", cpumask, cpumasklen); 
-	else
-		xasprintf(&env[ei++], "AFFECTED_CPUS=unknown");
-	env[ei] = NULL;	
-	assert(ei < MAX_ENV);
-
-	run_trigger(yellow_trigger, NULL, env, false, "yellow");
-	for (i = 0; i < ei; i++) {
-		free(env[i]);
-		env[i] = NULL;
-	}
+		trigger_env_add(&env, "SOCKETID=%d", socket);
+	trigger_env_add(&env, "MESSAGE=%s", msg);
+	trigger_env_add(&env, "CPU=%d", cpu);
+	trigger_env_add(&env, "LEVEL=%d", lnum);
+	trigger_env_add(&env, "TYPE=%s", ts);
+	/* precomputed per cache instance */
+	trigger_env_put(&env, yc->affected);
+
+	run_trigger(yellow_trigger, NULL, trigger_env(&env), false, "yellow");
 out:
 	free(msg);
 	msg = NULL;
 }
 
+/*
+ * Track the cache instances of the candidate policy apart from the live
+ * ones, until switched back.
+ */
+void yellow_use(enum acct_db db)
+{
+	if (db == DB_CANDIDATE) {
+		yellow_caches = &candidate_caches;
+		yellow_mem = MEM_POLICY;
+	} else {
+		yellow_caches = &live_caches;
+		yellow_mem = MEM_CACHE;
+	}
+}
+
 void yellow_setup(void)
 {
 	int n;
@@ -120,5 +234,9 @@ void yellow_setup(void)
 	n = config_bool("cache", "cache-threshold-log");
 	if (n >= 0)
 		yellow_log = n;
+
+	config_number("cache", "cache-threshold-rearm", "%u", &yellow_rearm);
+	trigger_template_init(&yellow_env);
+	mem_set_evict(MEM_CACHE, yellow_evict);
 }
 
@@ -1,2 +1,6 @@
+#include <time.h>
+
 void yellow_setup(void);
-void run_yellow_trigger(int cpu, int tnum, int lnum, char *ts, char *ls, int socket);
+void yellow_use(enum acct_db db);
+void run_yellow_trigger(int cpu, int tnum, int lnum, char *ts, char *ls, int socket,
+			time_t t);